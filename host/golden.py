@@ -0,0 +1,124 @@
+#!/usr/bin/env python
+"""
+Golden frames for the host verification. Keeps every frame `make verify` writes
+to build/frames_<set> as a palettised PNG in golden/<set>, and fails when a
+frame differs from its golden one by a single pixel.
+
+    golden.py check <build dir> <golden dir> <set>...
+    golden.py write <build dir> <golden dir> <set>...
+
+A set is a platform, or aplite_streamed for the streamed aplite ball.
+"""
+import os
+import struct
+import sys
+import zlib
+
+from texture import read_png
+
+BLACK_AND_WHITE = [(0, 0, 0), (255, 255, 255)]
+# The 64 colours of GColor8, two bits per channel
+COLORS = [(r * 85, g * 85, b * 85) for r in range(4) for g in range(4) for b in range(4)]
+
+
+def read_pnm(path):
+    """Returns width, height, whether the frame is colour and the RGB colour of every pixel"""
+    data = open(path, 'rb').read()
+    magic, size, maximum, pixels = data.split(b'\n', 3)
+    width, height = [int(value) for value in size.split()]
+    pixels = bytearray(pixels)
+    if magic == b'P5':
+        return width, height, False, [(value, value, value) for value in pixels]
+    if magic == b'P6':
+        return width, height, True, [tuple(pixels[i:i + 3]) for i in range(0, len(pixels), 3)]
+    raise ValueError('{} is not a PGM or PPM frame'.format(path))
+
+
+def chunk(kind, data):
+    return struct.pack('>I', len(data)) + kind + data + struct.pack('>I', zlib.crc32(kind + data) & 0xFFFFFFFF)
+
+
+def write_png(path, width, height, color, pixels):
+    palette = COLORS if color else BLACK_AND_WHITE
+    depth = 8 if color else 1
+    index = dict((rgb, i) for i, rgb in enumerate(palette))
+    raw = bytearray()
+    for y in range(height):
+        raw.append(0)
+        row = [index[rgb] for rgb in pixels[y * width:(y + 1) * width]]
+        if depth == 8:
+            raw.extend(row)
+        else:
+            for x in range(0, width, 8):
+                byte = 0
+                for bit, value in enumerate(row[x:x + 8]):
+                    byte |= value << (7 - bit)
+                raw.append(byte)
+    with open(path, 'wb') as png:
+        png.write(b'\x89PNG\r\n\x1a\n')
+        png.write(chunk(b'IHDR', struct.pack('>IIBBBBB', width, height, depth, 3, 0, 0, 0)))
+        png.write(chunk(b'PLTE', bytes(bytearray(value for rgb in palette for value in rgb))))
+        png.write(chunk(b'IDAT', zlib.compress(bytes(raw), 9)))
+        png.write(chunk(b'IEND', b''))
+
+
+def frames(directory):
+    return sorted(name for name in os.listdir(directory) if name.endswith(('.pgm', '.ppm')))
+
+
+def golden_name(frame):
+    return os.path.splitext(frame)[0] + '.png'
+
+
+def write(build, golden, name):
+    source = os.path.join(build, 'frames_' + name)
+    target = os.path.join(golden, name)
+    if not os.path.isdir(target):
+        os.makedirs(target)
+    for old in os.listdir(target):
+        os.remove(os.path.join(target, old))
+    for frame in frames(source):
+        width, height, color, pixels = read_pnm(os.path.join(source, frame))
+        write_png(os.path.join(target, golden_name(frame)), width, height, color, pixels)
+    print('golden {}: {} frames written'.format(name, len(frames(source))))
+    return True
+
+
+def check(build, golden, name):
+    source = os.path.join(build, 'frames_' + name)
+    target = os.path.join(golden, name)
+    rendered = frames(source)
+    expected = sorted(os.listdir(target)) if os.path.isdir(target) else []
+    ok = [golden_name(frame) for frame in rendered] == expected
+    if not ok:
+        print('golden {}: FAIL, {} frames rendered, {} golden'.format(name, len(rendered), len(expected)))
+    for frame in rendered:
+        path = os.path.join(target, golden_name(frame))
+        if not os.path.exists(path):
+            continue
+        width, height, _, pixels = read_pnm(os.path.join(source, frame))
+        goldenwidth, goldenheight, goldenpixels = read_png(path)
+        if (goldenwidth, goldenheight) != (width, height):
+            print('golden {}/{}: FAIL, {}x{} instead of {}x{}'.format(
+                name, frame, width, height, goldenwidth, goldenheight))
+            ok = False
+            continue
+        differ = sum(1 for a, b in zip(pixels, goldenpixels) if a != b)
+        if differ:
+            print('golden {}/{}: FAIL, {} pixels differ'.format(name, frame, differ))
+            ok = False
+    if ok:
+        print('golden {}: PASS, {} frames'.format(name, len(rendered)))
+    return ok
+
+
+def main():
+    if len(sys.argv) < 4 or sys.argv[1] not in ('check', 'write'):
+        sys.exit(__doc__)
+    command = check if sys.argv[1] == 'check' else write
+    results = [command(sys.argv[2], sys.argv[3], name) for name in sys.argv[4:]]
+    sys.exit(0 if all(results) else 1)
+
+
+if __name__ == '__main__':
+    main()
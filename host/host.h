@@ -0,0 +1,15 @@
+#pragma once
+// Host only helpers on top of the SDK stand-ins in pebble.h and sdk.c
+
+#include <pebble.h>
+
+// Context whose framebuffer has the platform's display size and format
+GContext *host_graphics_context(void);
+// Layer covering the whole display
+Layer *host_layer(void);
+// Blank bitmap wrapping data in the given format, as gbitmap_create_with_resource
+// would return it
+GBitmap *host_bitmap_create(GSize size, GBitmapFormat format, uint8_t *data,
+  uint16_t bytes_per_row, GColor *palette);
+// Contents of the resource every resource id loads, a PBI for streamed balls
+void host_resource_set(const uint8_t *data, size_t size);
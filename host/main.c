@@ -0,0 +1,178 @@
+#include "host.h"
+#include "ball.h"
+#include "bench.h"
+#include "verify.h"
+#include "palette.h"
+
+// Host runner for the on-watch renderer benchmark and verification. It renders
+// with the platform's display geometry and the globe texture converted to the
+// format named on the command line:
+//
+//   bench_<platform> 1bit|streamed|8bit|4bitpal|2bitpal
+//   verify_<platform> 1bit|streamed|8bit [image directory]
+//
+// streamed, on aplite only, reads the 1-bit texture through create_ball_streamed
+// from a PBI resource built from it.
+// verify writes every checked frame to the image directory, as PGM on black
+// and white platforms and PPM on colour ones.
+
+#ifdef PBL_PLATFORM_EMERY
+#define HOST_GLOBE_RADIUS 75
+#else
+#define HOST_GLOBE_RADIUS 60
+#endif
+
+extern const int host_texture_width;
+extern const int host_texture_height;
+extern const uint8_t host_texture_bw[];
+extern const uint8_t host_texture_color[];
+
+#ifdef PBL_COLOR
+#define HOST_FORMATS "8bit|4bitpal|2bitpal"
+#define HOST_IMAGE_EXTENSION "ppm"
+#define HOST_IMAGE_MAGIC "P6"
+#elif defined(PBL_PLATFORM_APLITE)
+#define HOST_FORMATS "1bit|streamed"
+#define HOST_IMAGE_EXTENSION "pgm"
+#define HOST_IMAGE_MAGIC "P5"
+#else
+#define HOST_FORMATS "1bit"
+#define HOST_IMAGE_EXTENSION "pgm"
+#define HOST_IMAGE_MAGIC "P5"
+#endif
+
+static bool parse_format(const char *name, GBitmapFormat *format, bool *streamed) {
+  *streamed = false;
+#ifdef PBL_COLOR
+  if (strcmp(name, "8bit") == 0) *format = GBitmapFormat8Bit;
+  else if (strcmp(name, "4bitpal") == 0) *format = GBitmapFormat4BitPalette;
+  else if (strcmp(name, "2bitpal") == 0) *format = GBitmapFormat2BitPalette;
+  else return false;
+#else
+  if (strcmp(name, "1bit") == 0) *format = GBitmapFormat1Bit;
+#ifdef PBL_PLATFORM_APLITE
+  else if (strcmp(name, "streamed") == 0) {
+    *format = GBitmapFormat1Bit;
+    *streamed = true;
+  }
+#endif
+  else return false;
+#endif
+  return true;
+}
+
+// The globe texture in the given format, palettised ones are copied from the 8-bit
+// texture the way the verification derives them
+static GBitmap *create_texture(GBitmapFormat format) {
+  int width = host_texture_width;
+  int height = host_texture_height;
+#ifdef PBL_COLOR
+  if (format == GBitmapFormat4BitPalette || format == GBitmapFormat2BitPalette) {
+    GBitmap *texture = create_texture(GBitmapFormat8Bit);
+    GBitmap *palettised = create_palettised(texture, format);
+    gbitmap_destroy(texture);
+    return palettised;
+  }
+#endif
+  int rowbytes = format == GBitmapFormat1Bit ? (width + 31) / 32 * 4 : width;
+  uint8_t *data = calloc(rowbytes, height);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      if (format == GBitmapFormat1Bit) {
+        if (host_texture_bw[y * width + x]) data[y * rowbytes + (x >> 3)] |= 0x80 >> (x & 0x07);
+      } else {
+        data[y * rowbytes + x] = host_texture_color[y * width + x];
+      }
+    }
+  }
+  return host_bitmap_create(GSize(width, height), format, data, rowbytes, NULL);
+}
+
+// The texture as an uncompressed PBI resource: rowbytes, flags with the format
+// in bits 1-5, the bounds, then the rows
+static uint8_t *create_resource(GBitmap *texture, size_t *size) {
+  GRect bounds = gbitmap_get_bounds(texture);
+  uint16_t rowbytes = gbitmap_get_bytes_per_row(texture);
+  int16_t header[6] = { rowbytes, gbitmap_get_format(texture) << 1, 0, 0, bounds.size.w, bounds.size.h };
+  *size = sizeof(header) + rowbytes * bounds.size.h;
+  // Resources are not on the app heap
+  uint8_t *resource = (malloc)(*size);
+  memcpy(resource, header, sizeof(header));
+  memcpy(resource + sizeof(header), gbitmap_get_data(texture), rowbytes * bounds.size.h);
+  return resource;
+}
+
+#ifdef GLOBE_VERIFY
+static void write_frame(const char *directory, int frame, GBitmap *framebuffer) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/frame%03d.%s", directory, frame, HOST_IMAGE_EXTENSION);
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    perror(path);
+    return;
+  }
+  GRect bounds = gbitmap_get_bounds(framebuffer);
+  fprintf(file, "%s\n%d %d\n255\n", HOST_IMAGE_MAGIC, bounds.size.w, bounds.size.h);
+  for (int y = 0; y < bounds.size.h; y++) {
+    GBitmapDataRowInfo info = gbitmap_get_data_row_info(framebuffer, y);
+    for (int x = 0; x < bounds.size.w; x++) {
+#ifdef PBL_COLOR
+      GColor8 color = { .argb = x >= info.min_x && x <= info.max_x ? info.data[x] : 0 };
+      uint8_t rgb[3] = { color.r * 85, color.g * 85, color.b * 85 };
+      fwrite(rgb, 1, sizeof(rgb), file);
+#else
+      fputc(((info.data[x >> 3] >> (x & 0x07)) & 1) ? 255 : 0, file);
+#endif
+    }
+  }
+  fclose(file);
+}
+#endif
+
+int main(int argc, char **argv) {
+  GBitmapFormat format;
+  bool streamed;
+  if (argc < 2 || argc > 3 || !parse_format(argv[1], &format, &streamed)) {
+    fprintf(stderr, "usage: %s %s\n", argv[0], HOST_FORMATS);
+    return 1;
+  }
+
+  // The same geometry as globe_geometry() in globe.c
+  int radius = PBL_DISPLAY_HEIGHT / 2 < HOST_GLOBE_RADIUS ? PBL_DISPLAY_HEIGHT / 2 : HOST_GLOBE_RADIUS;
+  int x = PBL_DISPLAY_WIDTH / 2;
+  int y = PBL_DISPLAY_HEIGHT / 2;
+#ifdef PBL_RECT
+  if (y > 60) y += 10;
+#endif
+
+  GBitmap *texture = create_texture(format);
+  uint8_t *resource = NULL;
+  Ball ball;
+  if (streamed) {
+    size_t size;
+    resource = create_resource(texture, &size);
+    host_resource_set(resource, size);
+    ball = create_ball_streamed(0, radius, x, y);
+  } else {
+    // Palettised textures keep their own kernels, create_ball would expand them
+    ball = create_ball_native(texture, radius, x, y);
+  }
+  if (!ball) {
+    fprintf(stderr, "%s: no ball for %s\n", argv[0], argv[1]);
+    return 1;
+  }
+#ifdef GLOBE_VERIFY
+  GContext *ctx = host_graphics_context();
+  int frame = 0;
+  while (verify_step(ball, texture, host_layer(), ctx, radius, x, y)) {
+    if (argc == 3) write_frame(argv[2], frame++, graphics_capture_frame_buffer(ctx));
+  }
+#else
+  while (benchmark_step(ball, host_layer(), host_graphics_context(), radius, x, y)) {
+  }
+#endif
+  destroy_ball(ball);
+  gbitmap_destroy(texture);
+  (free)(resource);
+  return 0;
+}
@@ -0,0 +1,157 @@
+#pragma once
+// Host stand-in for the parts of the Pebble SDK that ball.c, bench.c and
+// verify.c use. Build with one of PBL_PLATFORM_APLITE, _BASALT, _CHALK,
+// _DIORITE or _EMERY defined to get that platform's display geometry.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(PBL_PLATFORM_APLITE) || defined(PBL_PLATFORM_DIORITE)
+#define PBL_BW
+#define PBL_RECT
+#define PBL_DISPLAY_WIDTH 144
+#define PBL_DISPLAY_HEIGHT 168
+#elif defined(PBL_PLATFORM_BASALT)
+#define PBL_COLOR
+#define PBL_RECT
+#define PBL_DISPLAY_WIDTH 144
+#define PBL_DISPLAY_HEIGHT 168
+#elif defined(PBL_PLATFORM_CHALK)
+#define PBL_COLOR
+#define PBL_ROUND
+#define PBL_DISPLAY_WIDTH 180
+#define PBL_DISPLAY_HEIGHT 180
+#elif defined(PBL_PLATFORM_EMERY)
+#define PBL_COLOR
+#define PBL_RECT
+#define PBL_DISPLAY_WIDTH 200
+#define PBL_DISPLAY_HEIGHT 228
+#else
+#error "define PBL_PLATFORM_APLITE, _BASALT, _CHALK, _DIORITE or _EMERY"
+#endif
+
+// The watch toolchain's fast types are all 32 bits wide, keep the host's the
+// same so that sign and overflow behave as they do on the watch
+#undef uint_fast8_t
+#undef uint_fast16_t
+#undef int_fast8_t
+#undef int_fast16_t
+#define uint_fast8_t uint32_t
+#define uint_fast16_t uint32_t
+#define int_fast8_t int32_t
+#define int_fast16_t int32_t
+
+#define TRIG_MAX_RATIO 0xffff
+#define TRIG_MAX_ANGLE 0x10000
+int32_t sin_lookup(int32_t angle);
+int32_t cos_lookup(int32_t angle);
+int32_t atan2_lookup(int16_t y, int16_t x);
+
+typedef struct {
+  int16_t x;
+  int16_t y;
+} GPoint;
+
+typedef struct {
+  int16_t w;
+  int16_t h;
+} GSize;
+
+typedef struct {
+  GPoint origin;
+  GSize size;
+} GRect;
+
+#define GPoint(x, y) ((GPoint){ (x), (y) })
+#define GPointZero GPoint(0, 0)
+#define GSize(w, h) ((GSize){ (w), (h) })
+#define GRect(x, y, w, h) ((GRect){ { (x), (y) }, { (w), (h) } })
+#define GRectZero GRect(0, 0, 0, 0)
+
+typedef union {
+  uint8_t argb;
+  struct {
+    uint8_t b:2;
+    uint8_t g:2;
+    uint8_t r:2;
+    uint8_t a:2;
+  };
+} GColor8;
+typedef GColor8 GColor;
+
+#define GColorBlack ((GColor8){ .argb = 0xC0 })
+#define GColorWhite ((GColor8){ .argb = 0xFF })
+#define GColorClear ((GColor8){ .argb = 0x00 })
+
+typedef enum {
+  GBitmapFormat1Bit = 0,
+  GBitmapFormat8Bit,
+  GBitmapFormat1BitPalette,
+  GBitmapFormat2BitPalette,
+  GBitmapFormat4BitPalette,
+  GBitmapFormat8BitCircular,
+} GBitmapFormat;
+
+typedef struct GBitmap GBitmap;
+
+typedef struct {
+  uint8_t *data;
+  int16_t min_x;
+  int16_t max_x;
+} GBitmapDataRowInfo;
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap);
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap);
+GRect gbitmap_get_bounds(const GBitmap *bitmap);
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap);
+GColor *gbitmap_get_palette(const GBitmap *bitmap);
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap, uint16_t y);
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format);
+GBitmap *gbitmap_create_blank_with_palette(GSize size, GBitmapFormat format,
+  GColor *palette, bool free_on_destroy);
+void gbitmap_destroy(GBitmap *bitmap);
+
+typedef struct GContext GContext;
+GBitmap *graphics_capture_frame_buffer(GContext *ctx);
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer);
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+
+typedef struct Layer Layer;
+typedef struct Window Window;
+GRect layer_get_bounds(const Layer *layer);
+void layer_mark_dirty(Layer *layer);
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *data);
+
+typedef void *ResHandle;
+ResHandle resource_get_handle(uint32_t resource_id);
+size_t resource_size(ResHandle handle);
+size_t resource_load_byte_range(ResHandle handle, uint32_t start_offset, uint8_t *buffer, size_t num_bytes);
+
+// Allocations are counted against the platform's app heap, so heap_bytes_free()
+// falls as the renderer allocates like it does on the watch
+void *host_malloc(size_t size);
+void *host_calloc(size_t count, size_t size);
+void host_free(void *pointer);
+#define malloc(size) host_malloc(size)
+#define calloc(count, size) host_calloc(count, size)
+#define free(pointer) host_free(pointer)
+
+size_t heap_bytes_free(void);
+size_t heap_bytes_used(void);
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+
+typedef enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200,
+} AppLogLevel;
+
+#define APP_LOG(level, fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
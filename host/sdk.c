@@ -0,0 +1,258 @@
+#include <math.h>
+#include "host.h"
+
+// Heap free before the first allocation, roughly what the app leaves on the watch
+#if defined(PBL_PLATFORM_APLITE)
+#define HOST_HEAP_FREE (16 * 1024)
+#elif defined(PBL_PLATFORM_EMERY)
+#define HOST_HEAP_FREE (128 * 1024)
+#else
+#define HOST_HEAP_FREE (64 * 1024)
+#endif
+
+struct GBitmap {
+  uint8_t *data;
+  uint16_t bytes_per_row;
+  GRect bounds;
+  GBitmapFormat format;
+  GColor *palette;
+  bool free_palette;
+};
+
+struct GContext {
+  GBitmap *framebuffer;
+};
+
+struct Layer {
+  GRect bounds;
+};
+
+// Every block carries its size in front of it. The parenthesised names call the
+// C library past the macros in pebble.h.
+typedef union {
+  size_t size;
+  long double align;
+} HostBlock;
+
+static size_t s_heap_used;
+
+void *host_malloc(size_t size) {
+  if (size > heap_bytes_free()) return NULL;
+  HostBlock *block = (malloc)(sizeof(HostBlock) + size);
+  if (!block) return NULL;
+  block->size = size;
+  s_heap_used += size;
+  return block + 1;
+}
+
+void *host_calloc(size_t count, size_t size) {
+  void *pointer = host_malloc(count * size);
+  if (pointer) memset(pointer, 0, count * size);
+  return pointer;
+}
+
+void host_free(void *pointer) {
+  if (!pointer) return;
+  HostBlock *block = (HostBlock *)pointer - 1;
+  s_heap_used -= block->size;
+  (free)(block);
+}
+
+// The SDK's trig functions take angles in TRIG_MAX_ANGLE units and return
+// ratios scaled by TRIG_MAX_RATIO
+int32_t sin_lookup(int32_t angle) {
+  return (int32_t)lround(sin(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t cos_lookup(int32_t angle) {
+  return (int32_t)lround(cos(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+// Looked up in a table like the SDK does, libm's atan2 would make the rotated
+// path look several times slower than it is on the watch
+#define HOST_ATAN_STEPS 2048
+
+int32_t atan2_lookup(int16_t y, int16_t x) {
+  static int32_t atan_table[HOST_ATAN_STEPS + 1];
+  if (atan_table[HOST_ATAN_STEPS] == 0) {
+    for (int i = 0; i <= HOST_ATAN_STEPS; i++) {
+      atan_table[i] = (int32_t)lround(atan((double)i / HOST_ATAN_STEPS) * TRIG_MAX_ANGLE / (2 * M_PI));
+    }
+  }
+  int32_t ax = abs(x);
+  int32_t ay = abs(y);
+  if (ax == 0 && ay == 0) return 0;
+  int32_t angle = ax >= ay ?
+    atan_table[(ay * HOST_ATAN_STEPS + ax / 2) / ax] :
+    TRIG_MAX_ANGLE / 4 - atan_table[(ax * HOST_ATAN_STEPS + ay / 2) / ay];
+  if (x < 0) angle = TRIG_MAX_ANGLE / 2 - angle;
+  if (y < 0) angle = TRIG_MAX_ANGLE - angle;
+  return angle & (TRIG_MAX_ANGLE - 1);
+}
+
+static int bits_per_pixel(GBitmapFormat format) {
+  switch (format) {
+    case GBitmapFormat1Bit:
+    case GBitmapFormat1BitPalette: return 1;
+    case GBitmapFormat2BitPalette: return 2;
+    case GBitmapFormat4BitPalette: return 4;
+    default: return 8;
+  }
+}
+
+GBitmap *host_bitmap_create(GSize size, GBitmapFormat format, uint8_t *data,
+  uint16_t bytes_per_row, GColor *palette) {
+  GBitmap *bitmap = calloc(1, sizeof(GBitmap));
+  bitmap->data = data;
+  bitmap->bytes_per_row = bytes_per_row;
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  bitmap->format = format;
+  bitmap->palette = palette;
+  return bitmap;
+}
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap) {
+  return bitmap->data;
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap) {
+  return bitmap->bytes_per_row;
+}
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap) {
+  return bitmap->bounds;
+}
+
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap) {
+  return bitmap->format;
+}
+
+GColor *gbitmap_get_palette(const GBitmap *bitmap) {
+  return bitmap->palette;
+}
+
+// Rows of the round framebuffer only hold the pixels inside the display circle
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap, uint16_t y) {
+  GBitmapDataRowInfo info = { bitmap->data + y * bitmap->bytes_per_row, 0, bitmap->bounds.size.w - 1 };
+#ifdef PBL_ROUND
+  if (bitmap->format == GBitmapFormat8BitCircular) {
+    double radius = bitmap->bounds.size.w / 2.0;
+    double dy = y + 0.5 - radius;
+    double half = radius * radius > dy * dy ? sqrt(radius * radius - dy * dy) : 0;
+    info.min_x = (int16_t)(radius - half);
+    info.max_x = (int16_t)(radius + half) - 1;
+    if (info.max_x >= bitmap->bounds.size.w) info.max_x = bitmap->bounds.size.w - 1;
+  }
+#endif
+  return info;
+}
+
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format) {
+  int bits = bits_per_pixel(format);
+  uint16_t bytes_per_row = format == GBitmapFormat1Bit ?
+    (size.w + 31) / 32 * 4 : (size.w * bits + 7) / 8;
+  return host_bitmap_create(size, format, calloc(bytes_per_row, size.h), bytes_per_row, NULL);
+}
+
+GBitmap *gbitmap_create_blank_with_palette(GSize size, GBitmapFormat format,
+  GColor *palette, bool free_on_destroy) {
+  GBitmap *bitmap = gbitmap_create_blank(size, format);
+  bitmap->palette = palette;
+  bitmap->free_palette = free_on_destroy;
+  return bitmap;
+}
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  if (!bitmap) return;
+  if (bitmap->free_palette) free(bitmap->palette);
+  free(bitmap->data);
+  free(bitmap);
+}
+
+GContext *host_graphics_context(void) {
+  static GContext ctx;
+  if (!ctx.framebuffer) {
+    // The framebuffer is not on the app heap
+    size_t used = s_heap_used;
+#if defined(PBL_ROUND)
+    ctx.framebuffer = gbitmap_create_blank(GSize(PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT), GBitmapFormat8Bit);
+    ctx.framebuffer->format = GBitmapFormat8BitCircular;
+#elif defined(PBL_COLOR)
+    ctx.framebuffer = gbitmap_create_blank(GSize(PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT), GBitmapFormat8Bit);
+#else
+    ctx.framebuffer = gbitmap_create_blank(GSize(PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT), GBitmapFormat1Bit);
+#endif
+    s_heap_used = used;
+  }
+  return &ctx;
+}
+
+GBitmap *graphics_capture_frame_buffer(GContext *ctx) {
+  return ctx->framebuffer;
+}
+
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer) {
+  return true;
+}
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+}
+
+Layer *host_layer(void) {
+  static Layer layer = { { { 0, 0 }, { PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT } } };
+  return &layer;
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+  return layer->bounds;
+}
+
+void layer_mark_dirty(Layer *layer) {
+}
+
+// Callers step their state machines by hand, so timers never fire
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *data) {
+  return NULL;
+}
+
+// The only resource on the host is the one set with host_resource_set, every
+// resource id gets it, and none without it
+static const uint8_t *s_resource;
+static size_t s_resource_size;
+
+void host_resource_set(const uint8_t *data, size_t size) {
+  s_resource = data;
+  s_resource_size = size;
+}
+
+ResHandle resource_get_handle(uint32_t resource_id) {
+  return (ResHandle)s_resource;
+}
+
+size_t resource_size(ResHandle handle) {
+  return handle ? s_resource_size : 0;
+}
+
+size_t resource_load_byte_range(ResHandle handle, uint32_t start_offset, uint8_t *buffer, size_t num_bytes) {
+  if (!handle || start_offset >= s_resource_size) return 0;
+  if (num_bytes > s_resource_size - start_offset) num_bytes = s_resource_size - start_offset;
+  memcpy(buffer, s_resource + start_offset, num_bytes);
+  return num_bytes;
+}
+
+size_t heap_bytes_free(void) {
+  return s_heap_used < HOST_HEAP_FREE ? HOST_HEAP_FREE - s_heap_used : 0;
+}
+
+size_t heap_bytes_used(void) {
+  return s_heap_used;
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint16_t ms = now.tv_nsec / 1000000;
+  if (tloc) *tloc = now.tv_sec;
+  if (out_ms) *out_ms = ms;
+  return ms;
+}
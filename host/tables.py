@@ -0,0 +1,38 @@
+#!/usr/bin/env python
+"""
+Writes the renderer's generated lookup tables for one platform with the
+wscript's own generate_tables, so host builds get the same tables without waf.
+
+    tables.py <platform> <output.c>
+"""
+import os
+import sys
+
+
+class Node(object):
+    def __init__(self, path):
+        self.path = path
+
+    def write(self, text):
+        with open(self.path, 'w') as output:
+            output.write(text)
+
+
+class Task(object):
+    pass
+
+
+def main():
+    platform, output = sys.argv[1:3]
+    wscript = {}
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'wscript')
+    exec(compile(open(path).read(), path, 'exec'), wscript)
+    task = Task()
+    task.env = Task()
+    task.env.GLOBE_MAX_RADIUS = wscript['GLOBE_MAX_RADIUS'].get(platform, wscript['GLOBE_DEFAULT_MAX_RADIUS'])
+    task.outputs = [Node(output)]
+    wscript['generate_tables'](task)
+
+
+if __name__ == '__main__':
+    main()
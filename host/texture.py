@@ -0,0 +1,97 @@
+#!/usr/bin/env python
+"""
+Converts the globe textures to C arrays for host builds, which have no resource
+pack. Pixels are written one byte each: 0 or 1 for the black and white texture,
+GColor8 argb values for the colour texture.
+
+    texture.py <bw.png> <color.png> > texture.c
+
+Only reads what the textures use: palettised, 8 bits per channel palette,
+bit depths 1 to 8, no interlacing.
+"""
+import struct
+import sys
+import zlib
+
+
+def paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def read_png(path):
+    """Returns width, height and the RGB palette colour of every pixel"""
+    data = open(path, 'rb').read()
+    if data[:8] != b'\x89PNG\r\n\x1a\n':
+        raise ValueError('{} is not a PNG'.format(path))
+    offset = 8
+    idat = b''
+    palette = []
+    while offset < len(data):
+        length, kind = struct.unpack('>I4s', data[offset:offset + 8])
+        chunk = data[offset + 8:offset + 8 + length]
+        offset += 12 + length
+        if kind == b'IHDR':
+            width, height, depth, colortype, _, _, interlace = struct.unpack('>IIBBBBB', chunk)
+            if colortype != 3 or interlace != 0:
+                raise ValueError('{} is not a palettised, non interlaced PNG'.format(path))
+        elif kind == b'PLTE':
+            palette = [tuple(bytearray(chunk[i:i + 3])) for i in range(0, len(chunk), 3)]
+        elif kind == b'IDAT':
+            idat += chunk
+    raw = bytearray(zlib.decompress(idat))
+    stride = (width * depth + 7) // 8
+    bpp = max(1, depth // 8)
+    previous = bytearray(stride)
+    pixels = []
+    for y in range(height):
+        start = y * (stride + 1)
+        kind = raw[start]
+        line = raw[start + 1:start + 1 + stride]
+        for i in range(stride):
+            left = line[i - bpp] if i >= bpp else 0
+            up = previous[i]
+            upleft = previous[i - bpp] if i >= bpp else 0
+            if kind == 1:
+                line[i] = (line[i] + left) & 0xFF
+            elif kind == 2:
+                line[i] = (line[i] + up) & 0xFF
+            elif kind == 3:
+                line[i] = (line[i] + (left + up) // 2) & 0xFF
+            elif kind == 4:
+                line[i] = (line[i] + paeth(left, up, upleft)) & 0xFF
+        previous = line
+        for x in range(width):
+            bit = x * depth
+            index = (line[bit // 8] >> (8 - depth - bit % 8)) & ((1 << depth) - 1)
+            pixels.append(palette[index])
+    return width, height, pixels
+
+
+def write_array(name, values):
+    print('const uint8_t {}[{}] = {{'.format(name, len(values)))
+    for start in range(0, len(values), 24):
+        print('  ' + ', '.join(str(value) for value in values[start:start + 24]) + ',')
+    print('};')
+
+
+def main():
+    width, height, bw = read_png(sys.argv[1])
+    colorwidth, colorheight, color = read_png(sys.argv[2])
+    if (colorwidth, colorheight) != (width, height):
+        raise ValueError('the textures differ in size')
+    print('// Generated by host/texture.py, do not edit')
+    print('#include <stdint.h>')
+    print('')
+    print('const int host_texture_width = {};'.format(width))
+    print('const int host_texture_height = {};'.format(height))
+    write_array('host_texture_bw', [1 if sum(rgb) >= 384 else 0 for rgb in bw])
+    write_array('host_texture_color', [0xC0 | (r >> 6) << 4 | (g >> 6) << 2 | b >> 6
+                                       for r, g, b in color])
+
+
+if __name__ == '__main__':
+    main()
@@ -1,12 +1,37 @@
 #include <pebble.h>
 #include "ball.h"
-#include "message.h"
+#include "tables.h"
 
 #define FIXED_360_DEG 0x10000
 #define FIXED_360_DEG_SHIFT 16
 #define FIXED_180_DEG 0x8000
 #define FIXED_90_DEG 0x4000
 
+// Visible part of one globe row, [xmin, xmax), the half chord of the
+// circle at that row which scales the row's longitudes, the mip level
+// the row samples, and whether the coordinate cache holds the whole row
+// for the cached latitude
+typedef struct {
+  uint8_t xmin;
+  uint8_t xmax;
+  uint8_t width;
+  uint8_t level;
+  bool cached;
+  uint16_t mapoffset;
+  uint16_t cacheoffset;
+} BallSpan;
+
+// Texture mip level: level 0 is the texture itself, each further level halves
+// both dimensions for the rows that pack several texels into a pixel
+typedef struct {
+  const uint8_t **rows;
+  uint8_t *data;
+  int rowbytes;
+  GSize size;
+} BallLevel;
+
+#define BALL_MIP_LEVELS 3
+
 struct ball {
   GBitmap *bitmap;
   uint8_t* bitmap_data;
@@ -14,218 +39,1235 @@ struct ball {
   GBitmapFormat format;
   GRect bitmapbounds;
   int bitmapsize;
+  const uint8_t **rows;
+  ResHandle resource;
+  uint8_t *streamdata;
+  uint8_t *streamline;
+  uint16_t *streamused;
+  uint8_t *lineslot;
+  int streamslots;
+  uint16_t streamstamp;
+  BallLevel levels[BALL_MIP_LEVELS];
+  BallLevel *level;
   int8_t radius;
   uint_fast16_t radiusx2;
   uint_fast8_t centerx, centery;
-  int32_t *arccos;
+  uint16_t *arccos;
+  int arccoscapacity;
+  int arccosradius;
+  BallSpan *spans;
+  int spancapacity;
+  uint_fast8_t spantop;
+  uint_fast8_t spanrows;
+  uint16_t *longitudemap;
+  int longitudemapcapacity;
+  uint16_t *cachelongitude;
+  uint8_t *cacheline;
+  int cachecapacity;
+  uint_fast8_t cachedrows;
+  int cachedlatitude;
+  bool tablesready;
+  bool inverted;
+  BallQuality quality;
+  BallField field;
 #ifdef PBL_COLOR
   GColor* palette;
+  uint8_t *expandeddata;
+  bool expand;
 #endif
 };
 
-#define DRAW_BW_PIXEL( framebuffer, x, yoffset, color ) \
-      ((color) != 0 ? (framebufferdata[yoffset + ((x) >> 3)] |= ((1) << ((x) & 0x07))) : \
-                    (framebufferdata[yoffset + ((x) >> 3)] &= ~((1) << ((x) & 0x07))));
+// Byte of a framebuffer row holding screen column x
+#ifdef PBL_COLOR
+#define ROW_BYTE( x ) (x)
+#else
+#define ROW_BYTE( x ) ((x) >> 3)
+#endif
+
+// Optional tables are only allocated while this much heap stays free
+#ifdef PBL_PLATFORM_APLITE
+#define BALL_HEAP_RESERVE 4096
+#else
+#define BALL_HEAP_RESERVE 8192
+#endif
 
-#define DRAW_COLOR_PIXEL( framebuffer, x, yoffset, color ) \
-      (framebufferdata[yoffset + (x)] = color);
+// Largest radius whose pixels stay within the sqrt table
+static int clamp_radius(int radius) {
+  while (radius > 0 && (radius + 2) * (radius + 2) > sqrt_lookup_size) radius--;
+  return radius;
+}
 
-#define DRAW_ROUND_PIXEL( rowdata, x, color ) \
-      (rowdata[x] = color);
+// arccos entries per pixel of radius, so that the ratios of a row's
+// longitudes are looked up with sub-pixel precision
+#define BALL_ARCCOS_SUBPIXELS 4
 
-#ifdef PBL_PLATFORM_EMERY
-#define SQRT_LOOKUP_SIZE 12000
+// arccos[k] is the angle nearest to arccos(k / (radius * BALL_ARCCOS_SUBPIXELS))
+// for every k up to that denominator, plus a zero entry for longitude indices
+// rounded past the edge of a row. Each entry is bisected from cos_lookup,
+// so the table has no holes at any radius. It is only rebuilt for a new radius.
+static void init_arccos(Ball ball) {
+  if (ball->arccos && ball->arccosradius == ball->radius) return;
+  ball->arccosradius = ball->radius;
+  int size = ball->radius * BALL_ARCCOS_SUBPIXELS;
+  if (ball->arccoscapacity < size + 2) {
+    free(ball->arccos);
+    ball->arccoscapacity = size + 2;
+    ball->arccos = malloc(sizeof(uint16_t) * ball->arccoscapacity);
+  }
+  int high = FIXED_90_DEG;
+  for (int k = 0; k <= size + 1; k++) {
+    int32_t target = (int32_t)k << FIXED_360_DEG_SHIFT;
+    // Smallest angle with size * cos(angle) <= target, the table decreases with k
+    int low = 0;
+    while (low < high) {
+      int middle = (low + high) / 2;
+      if (cos_lookup(middle) * size <= target) {
+        high = middle;
+      } else {
+        low = middle + 1;
+      }
+    }
+    if (high > 0 && cos_lookup(high - 1) * size - target < target - cos_lookup(high) * size) {
+      ball->arccos[k] = high - 1;
+    } else {
+      ball->arccos[k] = high;
+    }
+  }
+}
+
+// Fixed-point arccos indices per pixel along row ydiff: radius * BALL_ARCCOS_SUBPIXELS
+// over the exact half chord of the row, radius * sin(latitude). Zero for the empty pole row.
+static int32_t longitude_step(Ball ball, int ydiff) {
+  int32_t sinlatitude = sin_lookup(ball->arccos[ydiff * BALL_ARCCOS_SUBPIXELS]);
+  return sinlatitude > 0 ? ((int64_t)BALL_ARCCOS_SUBPIXELS << 32) / sinlatitude : 0;
+}
+
+// Heap budget for the rotated path's texture coordinate cache, 3 bytes per pixel.
+// A full globe needs 34 KB at radius 60 and 53 KB at radius 75, smaller budgets
+// cache as many leading rows as fit and compute the rest every frame.
+#if defined(PBL_PLATFORM_APLITE)
+#define BALL_CACHE_BUDGET 3072
+#elif defined(PBL_PLATFORM_EMERY)
+#define BALL_CACHE_BUDGET 56000
 #else
-#define SQRT_LOOKUP_SIZE 4500
+#define BALL_CACHE_BUDGET 16384
+#endif
+#define BALL_CACHE_PIXEL_BYTES (sizeof(uint16_t) + sizeof(uint8_t))
+
+static void *malloc_optional(size_t size) {
+  if (heap_bytes_free() < size + BALL_HEAP_RESERVE) return NULL;
+  return malloc(size);
+}
+
+#ifdef PBL_COLOR
+#define TEXTURE_INVERT_MASK 0x7F
+#else
+#define TEXTURE_INVERT_MASK 0xFF
+#endif
+
+// Texture lines held in RAM when the texture is streamed from its resource
+// because the heap can not hold it whole. Streaming reads the resource during
+// spins, so it is only a fallback. Platforms without it always load the bitmap.
+#ifdef PBL_PLATFORM_APLITE
+#define BALL_STREAM_ROWS 16
 #endif
-static int8_t sqrt_lookup[SQRT_LOOKUP_SIZE];
 
-// http://en.wikipedia.org/wiki/Fast_inverse_square_root
-#define SQRT_MAGIC_F 0x5f3759df
-inline float  sqrt_fast(const float x){
-  union
-  {
-    float x;
-    int i;
-  } u;
-  u.x = x;
-  u.i = SQRT_MAGIC_F - (u.i >> 1);
+#define BALL_PBI_HEADER 12
+#define BALL_NO_SLOT 0xFF
 
-  // newton step for increased accuracy
-  return x * u.x * (1.5f - 0.5f * x * u.x * u.x);
+// Pointer to every texture line, NULL for streamed lines not in RAM
+static void init_rows(Ball ball) {
+  ball->rows = malloc(sizeof(uint8_t *) * ball->bitmapbounds.size.h);
+  for (int line = 0; line < ball->bitmapbounds.size.h; line++) {
+    ball->rows[line] = ball->bitmap_data ? ball->bitmap_data + line * ball->bitmapwidth : NULL;
+  }
+  memset(ball->levels, 0, sizeof(ball->levels));
+  ball->levels[0].rows = ball->rows;
+  ball->levels[0].rowbytes = ball->bitmapwidth;
+  ball->levels[0].size = ball->bitmapbounds.size;
+  ball->level = &ball->levels[0];
 }
 
-void init_sqrt() {
-  for (int i = 0; i < SQRT_LOOKUP_SIZE; i++) {
-    sqrt_lookup[i] = sqrt_fast(i);
+static void load_line(Ball ball, uint_fast8_t slot, uint_fast8_t line) {
+  uint8_t *data = ball->streamdata + slot * ball->bitmapwidth;
+  uint_fast8_t evicted = ball->streamline[slot];
+  if (evicted != BALL_NO_SLOT) {
+    ball->lineslot[evicted] = BALL_NO_SLOT;
+    ball->rows[evicted] = NULL;
+  }
+  resource_load_byte_range(ball->resource, BALL_PBI_HEADER + line * ball->bitmapwidth, data, ball->bitmapwidth);
+  if (ball->inverted) {
+    for (int i = 0; i < ball->bitmapwidth; i++) {
+      data[i] ^= TEXTURE_INVERT_MASK;
+    }
   }
+  ball->streamline[slot] = line;
+  ball->lineslot[line] = slot;
+  ball->rows[line] = data;
 }
 
-static void init_arccos(Ball ball) {
-  // 0 to 90 deegreed in 0.5 degree steps
-  for (int a = 0; a < FIXED_90_DEG; a+=91) {
-    int32_t x = (FIXED_180_DEG + cos_lookup(a) * ball->radius) / FIXED_360_DEG;
-    ball->arccos[x] = a;
+// Makes the texture lines of up to count pixels resident and returns how many
+// pixels from the start can be drawn. Lines of those pixels stay pinned while
+// the least recently used other line is evicted for each missing one.
+static int stream_lines(Ball ball, const uint8_t *lines, int count) {
+  if (++ball->streamstamp == 0) {
+    memset(ball->streamused, 0, sizeof(uint16_t) * ball->streamslots);
+    ball->streamstamp = 1;
   }
+  uint16_t stamp = ball->streamstamp;
+  int i;
+  for (i = 0; i < count; i++) {
+    uint_fast8_t slot = ball->lineslot[lines[i]];
+    if (slot == BALL_NO_SLOT) {
+      slot = 0;
+      for (int s = 1; s < ball->streamslots; s++) {
+        if (ball->streamused[s] < ball->streamused[slot]) slot = s;
+      }
+      if (ball->streamused[slot] == stamp) break;
+      load_line(ball, slot, lines[i]);
+    }
+    ball->streamused[slot] = stamp;
+  }
+  return i;
 }
 
-Ball create_ball(GBitmap *bitmap, int radius, int x, int y) {
-  Ball ball = malloc(sizeof(struct ball));
-  APP_LOG(APP_LOG_LEVEL_INFO, "Ball allocated %d bytes, position(%d, %d)", (int)sizeof(struct ball), x, y);
-  ball->bitmap_data = gbitmap_get_data(bitmap);
-  ball->bitmapwidth = gbitmap_get_bytes_per_row(bitmap);
-  ball->bitmapbounds = gbitmap_get_bounds(bitmap);
-  ball->format = gbitmap_get_format(bitmap);
+// Palettised textures are expanded to 8-bit once on these platforms, trading
+// width * height bytes of heap for the shift, mask and palette lookup per pixel
+#if defined(PBL_PLATFORM_BASALT) || defined(PBL_PLATFORM_CHALK) || defined(PBL_PLATFORM_EMERY)
+#define BALL_EXPAND_PALETTE
+#endif
+
+#ifdef PBL_COLOR
+// Tried once, by the first render, so the frame buffers come first
+static void expand_texture(Ball ball) {
+  if (!ball->expand) return;
+  ball->expand = false;
+  if (ball->format != GBitmapFormat4BitPalette && ball->format != GBitmapFormat2BitPalette) return;
+  int width = ball->bitmapbounds.size.w;
+  int height = ball->bitmapbounds.size.h;
+#ifdef BALL_EXPAND_PALETTE
+  ball->expandeddata = malloc_optional(width * height);
+#endif
+  if (!ball->expandeddata) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "Texture kept in format %d, 8-bit needs %d bytes", (int)ball->format, width * height);
+    return;
+  }
+  for (int y = 0; y < height; y++) {
+    const uint8_t *row = ball->bitmap_data + y * ball->bitmapwidth;
+    uint8_t *expanded = ball->expandeddata + y * width;
+    for (int x = 0; x < width; x++) {
+      if (ball->format == GBitmapFormat4BitPalette) {
+        expanded[x] = ball->palette[(row[x >> 1] >> (1 - (x & 0x01)) * 4) & 0x0F].argb;
+      } else {
+        expanded[x] = ball->palette[(row[x >> 2] >> (3 - (x & 0x03)) * 2) & 0x03].argb;
+      }
+    }
+  }
+  APP_LOG(APP_LOG_LEVEL_INFO, "Texture expanded from format %d to 8-bit, %d bytes", (int)ball->format, width * height);
+  ball->bitmap_data = ball->expandeddata;
+  ball->bitmapwidth = width;
+  ball->bitmapsize = width * height;
+  ball->format = GBitmapFormat8Bit;
+  for (int line = 0; line < height; line++) {
+    ball->rows[line] = ball->bitmap_data + line * width;
+  }
+  ball->levels[0].rowbytes = width;
+}
+#endif
+
+// Coarsest mip level that still has a texel per pixel along an unrotated row
+// whose half chord is width pixels. A quarter of the texture's columns spans the
+// half chord, so rows towards the poles and the limb pack more texels per pixel.
+static int mip_level(Ball ball, int width) {
+  int level = 0;
+  while (level + 1 < BALL_MIP_LEVELS && (ball->bitmapbounds.size.w >> level) >= 8 * width) level++;
+  return level;
+}
+
+#ifdef PBL_COLOR
+// Per channel rounded average of four colours, alpha taken from the first
+static uint8_t average_color(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+  uint8_t color = a & 0xC0;
+  for (int shift = 0; shift < 6; shift += 2) {
+    int sum = ((a >> shift) & 0x03) + ((b >> shift) & 0x03) + ((c >> shift) & 0x03) + ((d >> shift) & 0x03);
+    color |= ((sum + 2) / 4) << shift;
+  }
+  return color;
+}
+#else
+#define TEXTURE_BIT( row, x ) \
+      (((row)[(x) >> 3] >> (7 - ((x) & 0x07))) & 1)
+#endif
+
+// Builds a level as the 2x2 box filter of the level above it. Only resident
+// 8-bit or 1-bit textures get mip levels, and only when the heap allows. Texels
+// are averaged uninverted, so ties round the same way in either look.
+static void build_level(Ball ball, int index) {
+  BallLevel *source = &ball->levels[index - 1];
+  BallLevel *level = &ball->levels[index];
+  if (level->rows || !source->rows || !ball->bitmap_data) return;
+#ifdef PBL_COLOR
+  if (ball->format != GBitmapFormat8Bit) return;
+  int rowbytes = (source->size.w + 1) / 2;
+#else
+  int rowbytes = ((source->size.w + 1) / 2 + 7) / 8;
+#endif
+  GSize size = GSize((source->size.w + 1) / 2, (source->size.h + 1) / 2);
+  level->data = malloc_optional(rowbytes * size.h);
+  level->rows = level->data ? malloc_optional(sizeof(uint8_t *) * size.h) : NULL;
+  if (!level->rows) {
+    free(level->data);
+    level->data = NULL;
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Mip level %d dropped, no heap for %d bytes", index, rowbytes * size.h);
+    return;
+  }
+  level->rowbytes = rowbytes;
+  level->size = size;
+  memset(level->data, 0, rowbytes * size.h);
+  for (int y = 0; y < size.h; y++) {
+    const uint8_t *top = source->rows[2 * y];
+    const uint8_t *bottom = source->rows[2 * y + 1 < source->size.h ? 2 * y + 1 : 2 * y];
+    uint8_t *row = level->data + y * rowbytes;
+    level->rows[y] = row;
+    for (int x = 0; x < size.w; x++) {
+      int left = 2 * x;
+      int right = 2 * x + 1 < source->size.w ? 2 * x + 1 : 2 * x;
+#ifdef PBL_COLOR
+      uint8_t mask = ball->inverted ? TEXTURE_INVERT_MASK : 0;
+      row[x] = average_color(top[left] ^ mask, top[right] ^ mask, bottom[left] ^ mask, bottom[right] ^ mask) ^ mask;
+#else
+      int sum = TEXTURE_BIT(top, left) + TEXTURE_BIT(top, right) + TEXTURE_BIT(bottom, left) + TEXTURE_BIT(bottom, right);
+      // Ties are set in the uninverted texture, so clear in the inverted one
+      if (ball->inverted ? sum > 2 : sum >= 2) row[x >> 3] |= 0x80 >> (x & 0x07);
+#endif
+    }
+  }
+  APP_LOG(APP_LOG_LEVEL_INFO, "Mip level %d built, %dx%d, %d bytes", index, size.w, size.h, rowbytes * size.h);
+}
+
+// Level a globe row samples. Rotated rows cross texel columns unrelated to
+// their chord, fewer than the level assumes near the limb, so they sample the
+// texture itself.
+static BallLevel *row_level(Ball ball, int row, bool rotated) {
+  return &ball->levels[rotated ? 0 : ball->spans[row].level];
+}
+
+static void free_level(BallLevel *level) {
+  free(level->rows);
+  free(level->data);
+  level->rows = NULL;
+  level->data = NULL;
+}
+
+// Builds the levels the rows want and frees the others. Rows whose level could
+// not be built sample the nearest finer one.
+static void init_levels(Ball ball) {
+  int wanted = 0;
+  for (int row = 0; row < (int)ball->spanrows; row++) {
+    int level = mip_level(ball, ball->spans[row].width);
+    if (level > wanted) wanted = level;
+  }
+  for (int index = BALL_MIP_LEVELS - 1; index > wanted; index--) {
+    free_level(&ball->levels[index]);
+  }
+  for (int index = 1; index <= wanted; index++) {
+    build_level(ball, index);
+  }
+  for (int row = 0; row < (int)ball->spanrows; row++) {
+    int level = mip_level(ball, ball->spans[row].width);
+    while (level > 0 && !ball->levels[level].rows) level--;
+    ball->spans[row].level = level;
+  }
+  ball->level = &ball->levels[0];
+}
+
+// Unrotated longitude of every pixel in the left half of the globe, one run of
+// width + 1 entries per distinct row, shared by the rows above and below the centre.
+// The right half mirrors it as 180 degrees minus the entry.
+static void init_longitudemap(Ball ball) {
+  int entries = 0;
+  int centery = ball->centery, top = ball->spantop;
+  for (int row = 0; row < (int)ball->spanrows; row++) {
+    int y = top + row;
+    if (y <= centery || 2 * centery - y < top) {
+      entries += ball->spans[row].width + 1;
+    }
+  }
+  if (ball->longitudemapcapacity < entries) {
+    free(ball->longitudemap);
+    ball->longitudemap = malloc_optional(sizeof(uint16_t) * entries);
+    ball->longitudemapcapacity = ball->longitudemap ? entries : 0;
+  }
+  if (!ball->longitudemap) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Longitude map dropped, no heap for %d bytes", (int)sizeof(uint16_t) * entries);
+    return;
+  }
+
+  int offset = 0;
+  for (int row = 0; row < (int)ball->spanrows; row++) {
+    int y = top + row;
+    int mirror = 2 * centery - y - top;
+    if (y > centery && mirror >= 0) {
+      // Below the centre, reuse the run of the row mirrored above it
+      ball->spans[row].mapoffset = ball->spans[mirror].mapoffset;
+      continue;
+    }
+    int width = ball->spans[row].width;
+    int32_t step = longitude_step(ball, abs(y - centery));
+    ball->spans[row].mapoffset = offset;
+    for (int xdiff = 0; xdiff <= width; xdiff++) {
+      ball->longitudemap[offset++] = ball->arccos[(xdiff * step + 0x8000) >> FIXED_360_DEG_SHIFT];
+    }
+  }
+}
+
+// Sizes the texture coordinate cache to the rows that fit the budget, or the
+// heap left above the reserve when that is less
+static void init_cache(Ball ball) {
+  int pixels = 0;
+  int rows = 0;
+  size_t spare = heap_bytes_free();
+  bool short_of_heap = spare < BALL_CACHE_BUDGET + BALL_HEAP_RESERVE;
+  int budget = !short_of_heap ? BALL_CACHE_BUDGET :
+    spare > BALL_HEAP_RESERVE ? (int)(spare - BALL_HEAP_RESERVE) : 0;
+  budget /= BALL_CACHE_PIXEL_BYTES;
+  while (rows < (int)ball->spanrows && pixels + ball->spans[rows].xmax - ball->spans[rows].xmin <= budget) {
+    ball->spans[rows].cacheoffset = pixels;
+    pixels += ball->spans[rows].xmax - ball->spans[rows].xmin;
+    rows++;
+  }
+  if (ball->cachecapacity < pixels) {
+    free(ball->cachelongitude);
+    free(ball->cacheline);
+    ball->cachelongitude = malloc_optional(sizeof(uint16_t) * pixels);
+    ball->cacheline = ball->cachelongitude ? malloc_optional(sizeof(uint8_t) * pixels) : NULL;
+    if (!ball->cacheline) {
+      free(ball->cachelongitude);
+      ball->cachelongitude = NULL;
+    }
+    ball->cachecapacity = ball->cacheline ? pixels : 0;
+  }
+  ball->cachedrows = ball->cacheline ? rows : 0;
+  if (short_of_heap && ball->cachedrows < ball->spanrows) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Coordinate cache cut to %d of %d rows by the heap",
+      (int)ball->cachedrows, (int)ball->spanrows);
+  }
+  ball->cachedlatitude = -1;
+}
+
+// Copies the pixels [startx, stopx) of a row, each buffer indexed from its own left
+static void copy_row(uint8_t *dst, int dstleft, const uint8_t *src, int srcleft,
+  uint_fast8_t startx, uint_fast8_t stopx) {
+#ifdef PBL_COLOR
+  memcpy(dst + startx - dstleft, src + startx - srcleft, stopx - startx);
+#else
+  int first = startx >> 3;
+  int last = (stopx - 1) >> 3;
+  uint8_t firstmask = 0xFF << (startx & 0x07);
+  uint8_t lastmask = 0xFF >> (7 - ((stopx - 1) & 0x07));
+  if (first == last) firstmask &= lastmask;
+  dst[first - dstleft] = (dst[first - dstleft] & ~firstmask) | (src[first - srcleft] & firstmask);
+  if (first == last) return;
+  memcpy(dst + first + 1 - dstleft, src + first + 1 - srcleft, last - first - 1);
+  dst[last - dstleft] = (dst[last - dstleft] & ~lastmask) | (src[last - srcleft] & lastmask);
+#endif
+}
+
+// Intersects the circle with the display, one span per globe row
+static void init_spans(Ball ball) {
+  int top = (int)ball->centery - ball->radius;
+  int bottom = (int)ball->centery + ball->radius;
+  if (ball->spancapacity < 2 * ball->radius) {
+    free(ball->spans);
+    ball->spancapacity = 2 * ball->radius;
+    ball->spans = malloc(sizeof(BallSpan) * ball->spancapacity);
+  }
+  if (top < 0) top = 0;
+  if (bottom > PBL_DISPLAY_HEIGHT) bottom = PBL_DISPLAY_HEIGHT;
+  ball->spantop = top;
+  ball->spanrows = bottom > top ? bottom - top : 0;
+
+  int halfwidth = ball->radius;
+  for (int row = 0; row < (int)ball->spanrows; row++) {
+    int ydiff = abs(top + row - (int)ball->centery);
+    // Largest xdiff with xdiff * xdiff + ydiff * ydiff < radius * radius, -1 if none
+    while (halfwidth >= 0 && halfwidth * halfwidth + ydiff * ydiff >= (int)ball->radiusx2) halfwidth--;
+    while (halfwidth < ball->radius && (halfwidth + 1) * (halfwidth + 1) + ydiff * ydiff < (int)ball->radiusx2) halfwidth++;
+    int xmin = (int)ball->centerx - halfwidth;
+    int xmax = (int)ball->centerx + halfwidth + 1;
+    if (xmin < 0) xmin = 0;
+    if (xmax > PBL_DISPLAY_WIDTH) xmax = PBL_DISPLAY_WIDTH;
+    if (xmax < xmin) xmax = xmin;
+    ball->spans[row].xmin = xmin;
+    ball->spans[row].xmax = xmax;
+    // A single pixel row maps to the centre longitude
+    ball->spans[row].width = halfwidth > 0 ? halfwidth : 1;
+    ball->spans[row].level = 0;
+  }
+}
+
+// The tables a ball renders without, built by the first render after the
+// geometry changes so that the caller's frame buffers are allocated before them
+// and they take the heap that is left. Each one that does not fit is logged.
+// The coordinate cache comes last, it only pays off for repeated frames at one
+// latitude, which frame buffers already keep.
+static void init_tables(Ball ball) {
+  if (ball->tablesready) return;
+  ball->tablesready = true;
+#ifdef PBL_COLOR
+  expand_texture(ball);
+#endif
+  init_longitudemap(ball);
+  init_levels(ball);
+  init_cache(ball);
+}
+
+static void free_tables(Ball ball) {
+  free(ball->longitudemap);
+  free(ball->cachelongitude);
+  free(ball->cacheline);
+  ball->longitudemap = NULL;
+  ball->longitudemapcapacity = 0;
+  ball->cachelongitude = NULL;
+  ball->cacheline = NULL;
+  ball->cachecapacity = 0;
+  ball->cachedrows = 0;
+  ball->cachedlatitude = -1;
+  for (int index = 1; index < BALL_MIP_LEVELS; index++) {
+    free_level(&ball->levels[index]);
+  }
+  ball->tablesready = false;
+}
+
+static void init_ball(Ball ball, int radius, int x, int y) {
+  radius = clamp_radius(radius);
+  init_rows(ball);
   ball->bitmapsize = ball->bitmapwidth * ball->bitmapbounds.size.h;
   ball->radius = radius;
   ball->radiusx2 = radius * radius;
   ball->centerx = x;
   ball->centery = y;
-  ball->arccos = malloc(sizeof(int32_t) * 81);
+  ball->arccos = NULL;
+  ball->arccoscapacity = 0;
+  ball->arccosradius = 0;
   init_arccos(ball);
+  ball->spans = NULL;
+  ball->spancapacity = 0;
+  init_spans(ball);
+  ball->longitudemap = NULL;
+  ball->cachelongitude = NULL;
+  ball->cacheline = NULL;
+  free_tables(ball);
+  ball->inverted = false;
+  ball->quality = BallQualityFull;
+  ball->field = BallFieldAll;
+}
+
+static Ball create_ball_from(GBitmap *bitmap, int radius, int x, int y, bool expand) {
+  Ball ball = malloc(sizeof(struct ball));
+  APP_LOG(APP_LOG_LEVEL_INFO, "Ball allocated %d bytes, position(%d, %d)", (int)sizeof(struct ball), x, y);
+  ball->bitmap_data = gbitmap_get_data(bitmap);
+  ball->bitmapwidth = gbitmap_get_bytes_per_row(bitmap);
+  ball->bitmapbounds = gbitmap_get_bounds(bitmap);
+  ball->format = gbitmap_get_format(bitmap);
+  ball->streamdata = NULL;
+  ball->streamline = NULL;
+  ball->streamused = NULL;
+  ball->lineslot = NULL;
+  ball->streamslots = 0;
 #ifdef PBL_COLOR
   ball->palette = gbitmap_get_palette(bitmap);
+  ball->expandeddata = NULL;
+  ball->expand = expand;
+#endif
+  init_ball(ball, radius, x, y);
+  return ball;
+}
+
+Ball create_ball(GBitmap *bitmap, int radius, int x, int y) {
+  return create_ball_from(bitmap, radius, x, y, true);
+}
+
+// Keeps palettised textures in their own format where create_ball would expand
+// them, so their kernels can be verified and measured
+Ball create_ball_native(GBitmap *bitmap, int radius, int x, int y) {
+  return create_ball_from(bitmap, radius, x, y, false);
+}
+
+// A ball reading its texture lines from a PBI resource on demand through a
+// small row cache, NULL where streaming is off or the resource does not hold
+// an uncompressed texture in the framebuffer's own format
+Ball create_ball_streamed(uint32_t resource_id, int radius, int x, int y) {
+#ifdef BALL_STREAM_ROWS
+  ResHandle resource = resource_get_handle(resource_id);
+  struct {
+    uint16_t rowbytes;
+    uint16_t flags;
+    int16_t x, y, w, h;
+  } header;
+  if (resource_load_byte_range(resource, 0, (uint8_t *)&header, sizeof(header)) != sizeof(header)) return NULL;
+  GBitmapFormat format = (header.flags >> 1) & 0x1F;
+#ifdef PBL_COLOR
+  if (format != GBitmapFormat8Bit) return NULL;
+#else
+  if (format != GBitmapFormat1Bit) return NULL;
+#endif
+  if (header.h <= 0 || header.h >= BALL_NO_SLOT || header.w <= 0 ||
+      resource_size(resource) < (size_t)(BALL_PBI_HEADER + header.rowbytes * header.h)) {
+    return NULL;
+  }
+
+  Ball ball = malloc(sizeof(struct ball));
+  if (!ball) return NULL;
+  ball->resource = resource;
+  ball->bitmap_data = NULL;
+  ball->bitmapwidth = header.rowbytes;
+  ball->bitmapbounds = GRect(0, 0, header.w, header.h);
+  ball->format = format;
+  ball->streamslots = BALL_STREAM_ROWS < header.h ? BALL_STREAM_ROWS : header.h;
+  ball->streamstamp = 0;
+  ball->streamdata = malloc(ball->streamslots * ball->bitmapwidth);
+  ball->streamline = malloc(ball->streamslots);
+  ball->streamused = malloc(sizeof(uint16_t) * ball->streamslots);
+  ball->lineslot = malloc(header.h);
+  if (!ball->streamdata || !ball->streamline || !ball->streamused || !ball->lineslot) {
+    free(ball->streamdata);
+    free(ball->streamline);
+    free(ball->streamused);
+    free(ball->lineslot);
+    free(ball);
+    return NULL;
+  }
+  memset(ball->streamline, BALL_NO_SLOT, ball->streamslots);
+  memset(ball->streamused, 0, sizeof(uint16_t) * ball->streamslots);
+  memset(ball->lineslot, BALL_NO_SLOT, header.h);
+#ifdef PBL_COLOR
+  ball->palette = NULL;
+  ball->expandeddata = NULL;
+  ball->expand = false;
 #endif
+  APP_LOG(APP_LOG_LEVEL_INFO, "Texture streamed through %d rows, %d bytes instead of %d",
+    ball->streamslots, ball->streamslots * ball->bitmapwidth, header.rowbytes * header.h);
+  init_ball(ball, radius, x, y);
   return ball;
+#else
+  return NULL;
+#endif
+}
+
+void ball_set_quality(Ball ball, BallQuality quality) {
+  ball->quality = quality;
 }
 
+// Renders skip the rows of the other field and leave them as they are in the
+// target, so alternating fields over a buffer holding the last frame interlaces
+void ball_set_field(Ball ball, BallField field) {
+  ball->field = field;
+}
+
+// Bakes the inverted look into the texture when the setting changes, so frames
+// never invert pixels. Palettised textures only invert their palette.
+void ball_set_inverted(Ball ball, bool inverted) {
+  if (ball->inverted == inverted) return;
+  ball->inverted = inverted;
+#ifdef PBL_COLOR
+  if (ball->format == GBitmapFormat4BitPalette || ball->format == GBitmapFormat2BitPalette) {
+    int colors = ball->format == GBitmapFormat4BitPalette ? 16 : 4;
+    for (int i = 0; i < colors; i++) {
+      ball->palette[i].argb ^= 0x7F;
+    }
+    return;
+  }
+#endif
+  uint8_t *data = ball->streamdata ? ball->streamdata : ball->bitmap_data;
+  int size = ball->streamdata ? ball->streamslots * ball->bitmapwidth : ball->bitmapsize;
+  for (int i = 0; i < size; i++) {
+    data[i] ^= TEXTURE_INVERT_MASK;
+  }
+  for (int index = 1; index < BALL_MIP_LEVELS; index++) {
+    BallLevel *level = &ball->levels[index];
+    for (int i = 0; level->data && i < level->rowbytes * level->size.h; i++) {
+      level->data[i] ^= TEXTURE_INVERT_MASK;
+    }
+  }
+}
+
+// Rebuilds the tables for a new radius or centre. The same geometry keeps them,
+// and the coordinate cache of the current latitude with them. A new geometry
+// frees the optional tables until the next render, for the new frame buffers.
 void update_ball(Ball ball, int radius, int x, int y) {
+  radius = clamp_radius(radius);
+  if (radius == ball->radius && x == (int)ball->centerx && y == (int)ball->centery) return;
   ball->bitmapsize = ball->bitmapwidth * ball->bitmapbounds.size.h;
   ball->radius = radius;
   ball->radiusx2 = radius * radius;
   ball->centerx = x;
   ball->centery = y;
+  free_tables(ball);
   init_arccos(ball);
+  init_spans(ball);
+}
+
+// Frees the optional tables until the next render, for a caller that needs the heap
+void ball_release_tables(Ball ball) {
+  free_tables(ball);
 }
 
 void destroy_ball(Ball ball) {
+  free_tables(ball);
   free(ball->arccos);
+  free(ball->spans);
+  free(ball->rows);
+  free(ball->streamdata);
+  free(ball->streamline);
+  free(ball->streamused);
+  free(ball->lineslot);
+#ifdef PBL_COLOR
+  free(ball->expandeddata);
+#endif
   free(ball);
 }
 
-void ball_update_proc(Ball ball, Layer *layer, GContext *ctx, int latitude_rotation, int longitude_rotation)
-{
-  graphics_context_set_stroke_color(ctx, GColorWhite);
-  GBitmap *framebuffer = graphics_capture_frame_buffer(ctx);
-  GRect bounds = gbitmap_get_bounds(framebuffer);
-#ifndef PBL_ROUND
-  uint8_t* framebufferdata = gbitmap_get_data(framebuffer);
-  uint8_t framebuffer_bytes_per_row = gbitmap_get_bytes_per_row(framebuffer);
+bool ball_get_inverted(Ball ball) {
+  return ball->inverted;
+}
+
+GBitmapFormat ball_get_format(Ball ball) {
+  return ball->format;
+}
+
+int ball_get_texture_width(Ball ball) {
+  return ball->bitmapbounds.size.w;
+}
+
+// Number of globe pixels ball_update_proc writes within bounds
+int ball_pixel_count(Ball ball, GRect bounds) {
+  int count = 0;
+  for (int row = 0; row < (int)ball->spanrows; row++) {
+    if ((int)ball->spantop + row >= bounds.size.h) break;
+    int xmax = ball->spans[row].xmax > bounds.size.w ? bounds.size.w : ball->spans[row].xmax;
+    if (xmax > ball->spans[row].xmin) count += xmax - ball->spans[row].xmin;
+  }
+  return count;
+}
+
+// Screen rectangle holding every globe pixel, widened to whole bytes on 1-bit
+// platforms so that buffers of it share the framebuffer's bit alignment
+GRect ball_get_bounds(Ball ball) {
+  int left = PBL_DISPLAY_WIDTH;
+  int right = 0;
+  for (int row = 0; row < (int)ball->spanrows; row++) {
+    if (ball->spans[row].xmin >= ball->spans[row].xmax) continue;
+    if (ball->spans[row].xmin < left) left = ball->spans[row].xmin;
+    if (ball->spans[row].xmax > right) right = ball->spans[row].xmax;
+  }
+  if (right <= left) return GRectZero;
+#ifndef PBL_COLOR
+  left &= ~0x07;
 #endif
-  int coslat = cos_lookup(latitude_rotation);
-  int sinlat = sin_lookup(latitude_rotation);
-  uint_fast8_t starty = ((int)ball->centery - ball->radius) < 0 ? 0 : ball->centery - ball->radius;
-  uint_fast8_t startx = ((int)ball->centerx - ball->radius) < 0 ? 0 : ball->centerx - ball->radius;
-  uint_fast8_t stopy = ((int)ball->centery + ball->radius) >= bounds.size.h ? (uint_fast8_t)bounds.size.h : (uint_fast8_t)(ball->centery + ball->radius);
-  uint_fast8_t stopx = ((int)ball->centerx + ball->radius) >= bounds.size.w ? (uint_fast8_t)bounds.size.w : (uint_fast8_t)(ball->centerx + ball->radius);
+  return GRect(left, ball->spantop, right - left, ball->spanrows);
+}
 
-  for (uint_fast8_t y = starty; y < stopy; y++) {
-#ifdef PBL_ROUND
-    GBitmapDataRowInfo info = gbitmap_get_data_row_info(framebuffer, y);
-    if ((int)startx < info.min_x) startx = info.min_x;
-    if ((int)stopx > info.max_x) stopx = info.max_x;
+// Blank bitmap in the framebuffer format covering ball_get_bounds, NULL when the
+// heap can not spare it
+GBitmap *ball_create_buffer(Ball ball) {
+  GRect bounds = ball_get_bounds(ball);
+  if (bounds.size.w <= 0) return NULL;
+#ifdef PBL_COLOR
+  GBitmapFormat format = GBitmapFormat8Bit;
+  int bytes = bounds.size.w * bounds.size.h;
 #else
-    uint_fast16_t yoffset = y*framebuffer_bytes_per_row;
+  GBitmapFormat format = GBitmapFormat1Bit;
+  int bytes = ((bounds.size.w + 31) / 32) * 4 * bounds.size.h;
 #endif
-    bool firstx = false;
-    int width = ball->radius;
-    int ydiff = abs(y - ball->centery);
-    uint_fast16_t originallatitude = (y > ball->centery ?
-      FIXED_180_DEG - ball->arccos[ydiff] : ball->arccos[ydiff]);
-    int sinlathead = ((ball->radius * sin_lookup(originallatitude)) >> FIXED_360_DEG_SHIFT);
+  if (heap_bytes_free() < (size_t)bytes + BALL_HEAP_RESERVE) return NULL;
+  return gbitmap_create_blank(bounds.size, format);
+}
+
+int ball_get_radius(Ball ball) {
+  return ball->radius;
+}
+
+#ifdef GLOBE_VERIFY
+// Projects a single screen pixel to texture coordinates, one pixel at a time.
+// This is the reference the optimised renderer is verified against.
+bool ball_texel(Ball ball, int x, int y, int latitude_rotation, int longitude_rotation,
+  uint16_t *latitude, uint16_t *longitude) {
+  int ydiff = abs(y - (int)ball->centery);
+  int cordx = ball->centerx - x;
+  int xdiff = abs(cordx);
+  if ((uint_fast16_t)(xdiff * xdiff + ydiff * ydiff) >= ball->radiusx2) return false;
+
+  int latitudeindex = ydiff * BALL_ARCCOS_SUBPIXELS;
+  int longitudeindex = (xdiff * longitude_step(ball, ydiff) + 0x8000) >> FIXED_360_DEG_SHIFT;
+  uint16_t originallatitude = (y > (int)ball->centery ?
+    FIXED_180_DEG - ball->arccos[latitudeindex] : ball->arccos[latitudeindex]);
+  uint16_t lon = (x > (int)ball->centerx ?
+    FIXED_180_DEG - ball->arccos[longitudeindex] : ball->arccos[longitudeindex]);
+  uint16_t lat = originallatitude;
+
+  if ((latitude_rotation & 0xFF00) != 0) {
+    int coslat = cos_lookup(latitude_rotation);
+    int sinlat = sin_lookup(latitude_rotation);
+    int sinlathead = ((ball->radius * sin_lookup(originallatitude) + 0x8000) >> FIXED_360_DEG_SHIFT);
     int cordz = ball->centery - y;
-    int cordzsinlat = sinlat * cordz;
-    int cordzcoslat = coslat * cordz;
-
-    for (uint_fast8_t x = startx; x < stopx; x++) {
-      int cordx = ball->centerx - x;
-      int xdiff = abs(cordx);
-      uint_fast16_t radiusx2 = xdiff * xdiff + ydiff * ydiff;
-      if (radiusx2 < ball->radiusx2) {
-        if (!firstx) {
-          firstx = true;
-          width = cordx;
-        }
-        uint16_t longitude = (x > ball->centerx ?
-          FIXED_180_DEG - ball->arccos[xdiff * ball->radius / width] :
-          ball->arccos[xdiff * ball->radius / width]);
-        uint16_t latitude = originallatitude;
-
-        if ((latitude_rotation & 0xFF00) != 0) {
-          // Convert to cartesian coordinates (confusion since y on screeen is z in 3d system)
-          int cordy = (sinlathead * sin_lookup(longitude)) >> FIXED_360_DEG_SHIFT;
-
-          // Multiplication (rotation by the x-axis)
-          // x'   | 1   0       0    | | x |     x' = x
-          // y' = | 0 cos(t)  sin(t) | | y | =>  y' = cos(t)*y + sin(t)*z
-          // z'   | 0 -sin(t) cos(t) | | z |     z' = -sin(t)*y + cos(t)*z
-          int xrot = cordx;
-          int yrot = (coslat * cordy + cordzsinlat) >> FIXED_360_DEG_SHIFT;
-          int zrot = (-sinlat * cordy + cordzcoslat) >> FIXED_360_DEG_SHIFT;
-
-          // convert to spherical coordinates
-          latitude = atan2_lookup(sqrt_lookup[xrot * xrot + yrot * yrot], zrot);
-          longitude = atan2_lookup(yrot, xrot);
-        }
-        // Rotate longitude
-        longitude += longitude_rotation;
-
-        uint_fast8_t lineposition = ((latitude * ball->bitmapbounds.size.w) >> FIXED_360_DEG_SHIFT) * ball->bitmapwidth;
-        uint_fast16_t rowposition = ((longitude * ball->bitmapbounds.size.w) >> FIXED_360_DEG_SHIFT);
-        uint8_t pixel = 0;
+    int cordy = (sinlathead * sin_lookup(lon) + 0x8000) >> FIXED_360_DEG_SHIFT;
+    int xrot = cordx;
+    int yrot = (coslat * cordy + sinlat * cordz + 0x8000) >> FIXED_360_DEG_SHIFT;
+    int zrot = (-sinlat * cordy + coslat * cordz + 0x8000) >> FIXED_360_DEG_SHIFT;
+    lat = atan2_lookup(sqrt_lookup[xrot * xrot + yrot * yrot], zrot);
+    lon = atan2_lookup(yrot, xrot);
+  }
+  *latitude = lat;
+  *longitude = lon + longitude_rotation;
+  return true;
+}
+
+// Texture width of the mip level screen row y samples at a latitude rotation
+int ball_get_row_texture_width(Ball ball, int y, int latitude_rotation) {
+  return row_level(ball, y - ball->spantop, (latitude_rotation & 0xFF00) != 0)->size.w;
+}
+
+// The framebuffer value ball_update_proc writes on screen row y for a texture coordinate
+uint8_t ball_texel_color(Ball ball, int y, int latitude_rotation, uint16_t latitude, uint16_t longitude) {
+  BallLevel *level = row_level(ball, y - ball->spantop, (latitude_rotation & 0xFF00) != 0);
+  int line = (latitude * level->size.w) >> FIXED_360_DEG_SHIFT;
+  int column = (longitude * level->size.w) >> FIXED_360_DEG_SHIFT;
+  // The pole at 180 degrees reads the last texture line, like the renderer
+  if (line > level->size.h - 1) line = level->size.h - 1;
+  uint8_t streamed = line;
+  if (!level->rows[line]) stream_lines(ball, &streamed, 1);
+  const uint8_t *row = level->rows[line];
+  uint8_t pixel = 0;
+#ifdef PBL_COLOR
+  if (ball->format == GBitmapFormat8Bit) {
+    pixel = row[column];
+  } else if (ball->format == GBitmapFormat4BitPalette) {
+    pixel = ball->palette[(row[column >> 1] >> (1 - (column & 0x01)) * 4) & 0x0F].argb;
+  } else if (ball->format == GBitmapFormat2BitPalette) {
+    pixel = ball->palette[(row[column >> 2] >> (3 - (column & 0x03)) * 2) & 0x03].argb;
+  }
+#else
+  pixel = (row[column >> 3] >> (7 - (column & 0x07))) & 1;
+#endif
+  return pixel;
+}
+#endif
+
+// Row kernels fetch one framebuffer row of texels from precomputed texture
+// coordinates. One kernel per texture format is picked per frame, so the pixel
+// loop has no format branches, and inversion is baked into the texture. Callers clamp lines to
+// the texture and columns are below the texture width by construction.
+typedef void (*BallKernel)(Ball ball, uint8_t *rowdata, uint_fast8_t startx, uint_fast8_t stopx,
+  const uint16_t *longitudes, const uint8_t *lines, uint16_t longitude_rotation);
+
+#define FETCH_8BIT( ball, line, column ) \
+      ((line)[column])
+#define FETCH_4BIT( ball, line, column ) \
+      ((ball)->palette[((line)[(column) >> 1] >> (1 - ((column) & 0x01)) * 4) & 0x0F].argb)
+#define FETCH_2BIT( ball, line, column ) \
+      ((ball)->palette[((line)[(column) >> 2] >> (3 - ((column) & 0x03)) * 2) & 0x03].argb)
+#define FETCH_1BIT( ball, line, column ) \
+      (((line)[(column) >> 3] >> (7 - ((column) & 0x07))) & 1)
+
+#define STORE_PIXEL( rowdata, x, pixel ) \
+      ((rowdata)[x] = (pixel))
+
+#define DEFINE_KERNEL( name, FETCH, STORE ) \
+static void name(Ball ball, uint8_t *rowdata, uint_fast8_t startx, uint_fast8_t stopx, \
+  const uint16_t *longitudes, const uint8_t *lines, uint16_t longitude_rotation) { \
+  const uint8_t **rows = ball->level->rows; \
+  uint_fast16_t texturewidth = ball->level->size.w; \
+  for (uint_fast8_t x = startx; x < stopx; x++) { \
+    uint_fast16_t column = ((uint16_t)(*longitudes++ + longitude_rotation) * texturewidth) >> FIXED_360_DEG_SHIFT; \
+    const uint8_t *line = rows[*lines++]; \
+    STORE(rowdata, x, FETCH(ball, line, column)); \
+  } \
+}
+
 #ifdef PBL_COLOR
+DEFINE_KERNEL(kernel_8bit, FETCH_8BIT, STORE_PIXEL)
+DEFINE_KERNEL(kernel_4bit, FETCH_4BIT, STORE_PIXEL)
+DEFINE_KERNEL(kernel_2bit, FETCH_2BIT, STORE_PIXEL)
+#else
+// 1-bit framebuffer rows are assembled a byte at a time in a register, only
+// the partial bytes at the span edges read and mask the framebuffer
+static void kernel_1bit(Ball ball, uint8_t *rowdata, uint_fast8_t startx, uint_fast8_t stopx,
+  const uint16_t *longitudes, const uint8_t *lines, uint16_t longitude_rotation) {
+  const uint8_t **rows = ball->level->rows;
+  uint_fast16_t texturewidth = ball->level->size.w;
+  uint8_t *out = rowdata + (startx >> 3);
+  uint_fast8_t x = startx;
+  while (x < stopx) {
+    uint_fast8_t bit = x & 0x07;
+    uint_fast8_t count = stopx - x < 8 - bit ? stopx - x : 8 - bit;
+    uint_fast8_t byte = 0;
+    for (uint_fast8_t i = bit; i < bit + count; i++) {
+      uint_fast16_t column = ((uint16_t)(*longitudes++ + longitude_rotation) * texturewidth) >> FIXED_360_DEG_SHIFT;
+      const uint8_t *line = rows[*lines++];
+      byte |= FETCH_1BIT(ball, line, column) << i;
+    }
+    if (count == 8) {
+      *out = byte;
+    } else {
+      uint_fast8_t mask = ((1 << count) - 1) << bit;
+      *out = (*out & ~mask) | byte;
+    }
+    out++;
+    x += count;
+  }
+}
+#endif
 
-        if (ball->format == GBitmapFormat8Bit) {
-          uint16_t byteposition = lineposition + rowposition;
-          if (byteposition < ball->bitmapsize) {
-            pixel = ball->bitmap_data[byteposition];
-          }
-        } else if (ball->format == GBitmapFormat4BitPalette) {
-          uint16_t byteposition = lineposition + (rowposition >> 1);
-          if (byteposition < ball->bitmapsize) {
-            uint8_t byte = ball->bitmap_data[byteposition];
-            pixel = ball->palette[(byte >> (1 - (rowposition & 0x01)) * 4) & 0x0F].argb;
-          }
-        } else if (ball->format == GBitmapFormat2BitPalette) {
-          uint16_t byteposition = lineposition + (rowposition >> 2);
-          if (byteposition < ball->bitmapsize) {
-            uint8_t byte = ball->bitmap_data[byteposition];
-            pixel = ball->palette[(byte >> (3 - (rowposition & 0x03)) * 2) & 0x03].argb;
-          }
-        }
+static BallKernel select_kernel(Ball ball) {
+#ifdef PBL_COLOR
+  switch (ball->format) {
+    case GBitmapFormat8Bit:
+      return kernel_8bit;
+    case GBitmapFormat4BitPalette:
+      return kernel_4bit;
+    case GBitmapFormat2BitPalette:
+      return kernel_2bit;
+    default:
+      return NULL;
+  }
 #else
-        uint16_t byteposition = lineposition + (rowposition >> 3);
-        if (byteposition < ball->bitmapsize) {
-          uint8_t byte = ball->bitmap_data[byteposition];
-          pixel = (byte >> (7 - (rowposition & 0x07))) & 1;
-        }
+  return kernel_1bit;
 #endif
+}
+
+// Runs the kernel over a row, in pieces whose texture lines fit the row cache
+// when the texture is streamed
+static void draw_texels(Ball ball, BallKernel kernel, uint8_t *rowdata, uint_fast8_t startx, uint_fast8_t stopx,
+  const uint16_t *longitudes, const uint8_t *lines, uint16_t longitude_rotation) {
+  if (!ball->streamdata) {
+    kernel(ball, rowdata, startx, stopx, longitudes, lines, longitude_rotation);
+    return;
+  }
+  while (startx < stopx) {
+    int count = stream_lines(ball, lines, stopx - startx);
+    kernel(ball, rowdata, startx, startx + count, longitudes, lines, longitude_rotation);
+    startx += count;
+    longitudes += count;
+    lines += count;
+  }
+}
+
+// Texture coordinates of the row being drawn when they do not come from the cache
+static uint16_t s_row_longitudes[PBL_DISPLAY_WIDTH];
+static uint8_t s_row_lines[PBL_DISPLAY_WIDTH];
 
+// Moves the coordinates of the row above, drawn from fromstart to fromstop, under the
+// pixels startx to stopx of this row. Pixels past either end take the nearest one.
+static void reuse_row(int fromstart, int fromstop, int startx, int stopx) {
+  uint16_t firstlongitude = s_row_longitudes[0];
+  uint8_t firstline = s_row_lines[0];
+  uint16_t lastlongitude = s_row_longitudes[fromstop - fromstart - 1];
+  uint8_t lastline = s_row_lines[fromstop - fromstart - 1];
+  int overlapstart = startx > fromstart ? startx : fromstart;
+  int overlapstop = stopx < fromstop ? stopx : fromstop;
+  memmove(s_row_longitudes + overlapstart - startx, s_row_longitudes + overlapstart - fromstart,
+    sizeof(uint16_t) * (overlapstop - overlapstart));
+  memmove(s_row_lines + overlapstart - startx, s_row_lines + overlapstart - fromstart,
+    overlapstop - overlapstart);
+  for (int x = startx; x < overlapstart; x++) {
+    s_row_longitudes[x - startx] = firstlongitude;
+    s_row_lines[x - startx] = firstline;
+  }
+  for (int x = overlapstop; x < stopx; x++) {
+    s_row_longitudes[x - startx] = lastlongitude;
+    s_row_lines[x - startx] = lastline;
+  }
+}
+
+// Per frame state shared by the rows of one render
+typedef struct {
+  BallKernel kernel;
+  uint16_t longitude_rotation;
+  int coslat, sinlat;
+  bool rotated;
+  bool usecache;
+  bool fillcache;
+  bool half;
+  // The last row computed at half quality, stretched over the row below it
+  int halfy;
+  uint_fast8_t halfstartx, halfstopx;
+} BallPass;
+
+// Selects the kernel of a render, false if the texture format is not supported
+static bool begin_pass(Ball ball, BallPass *pass, int latitude_rotation, int longitude_rotation) {
+  pass->kernel = select_kernel(ball);
+  if (!pass->kernel) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Unsupported texture format %d", (int)ball->format);
+    return false;
+  }
+  pass->longitude_rotation = longitude_rotation;
+  pass->coslat = cos_lookup(latitude_rotation);
+  pass->sinlat = sin_lookup(latitude_rotation);
+  pass->rotated = (latitude_rotation & 0xFF00) != 0;
+  // The rotated path caches texture coordinates while the latitude stays put
+  pass->usecache = pass->rotated && latitude_rotation == ball->cachedlatitude;
+  pass->fillcache = false;
+  pass->half = false;
+  pass->halfy = -1;
+  pass->halfstartx = 0;
+  pass->halfstopx = 0;
+  return true;
+}
+
+// Draws the pixels [startx, stopx) of a globe row into rowdata, indexed by screen column
+static void render_row(Ball ball, BallPass *pass, uint_fast8_t row, uint8_t *rowdata,
+  uint_fast8_t startx, uint_fast8_t stopx) {
+  uint_fast8_t y = ball->spantop + row;
+  int latitudeindex = abs((int)y - (int)ball->centery) * BALL_ARCCOS_SUBPIXELS;
+  uint_fast16_t originallatitude = (y > ball->centery ?
+    FIXED_180_DEG - ball->arccos[latitudeindex] : ball->arccos[latitudeindex]);
+  int cacheindex = ball->spans[row].cacheoffset + startx - ball->spans[row].xmin;
+  // The kernels read the row's mip level
+  ball->level = row_level(ball, row, pass->rotated);
+  uint_fast16_t texturewidth = ball->level->size.w;
+  uint_fast16_t lastline = ball->level->size.h - 1;
+
+  if (!pass->rotated && ball->longitudemap) {
+    // Longitude only: the whole row reads one texture line, and the
+    // longitudes come from the map, mirrored on the right half
+    const uint16_t *rowmap = ball->longitudemap + ball->spans[row].mapoffset;
+    uint_fast16_t line = (originallatitude * texturewidth) >> FIXED_360_DEG_SHIFT;
+    uint_fast8_t centerx = ball->centerx;
+    uint_fast8_t leftstop = stopx < centerx + 1 ? stopx : centerx + 1;
+    uint_fast8_t rightstart = startx > centerx + 1 ? startx : centerx + 1;
+    uint16_t *longitudes = s_row_longitudes;
+    for (uint_fast8_t x = startx; x < leftstop; x++) {
+      *longitudes++ = rowmap[centerx - x];
+    }
+    for (uint_fast8_t x = rightstart; x < stopx; x++) {
+      *longitudes++ = FIXED_180_DEG - rowmap[x - centerx];
+    }
+    memset(s_row_lines, line < lastline ? line : lastline, stopx - startx);
+    draw_texels(ball, pass->kernel, rowdata, startx, stopx, s_row_longitudes, s_row_lines, pass->longitude_rotation);
+  } else if (pass->usecache && row < ball->cachedrows && ball->spans[row].cached) {
+    draw_texels(ball, pass->kernel, rowdata, startx, stopx, ball->cachelongitude + cacheindex,
+      ball->cacheline + cacheindex, pass->longitude_rotation);
+  } else if (pass->half && (y & 1) && pass->halfy == (int)y - 1 && startx < pass->halfstopx && stopx > pass->halfstartx) {
+    reuse_row(pass->halfstartx, pass->halfstopx, startx, stopx);
+    draw_texels(ball, pass->kernel, rowdata, startx, stopx, s_row_longitudes, s_row_lines, pass->longitude_rotation);
+  } else {
+    // Rows that fit the cache compute their coordinates straight into it
+    bool fillrow = pass->fillcache && row < ball->cachedrows;
+    uint16_t *longitudes = fillrow ? ball->cachelongitude + cacheindex : s_row_longitudes;
+    uint8_t *lines = fillrow ? ball->cacheline + cacheindex : s_row_lines;
+
+    int32_t step = longitude_step(ball, abs((int)y - (int)ball->centery));
+    int sinlathead = ((ball->radius * sin_lookup(originallatitude) + 0x8000) >> FIXED_360_DEG_SHIFT);
+    int cordz = ball->centery - y;
+    int cordzsinlat = pass->sinlat * cordz;
+    int cordzcoslat = pass->coslat * cordz;
+
+    // Rounded arccos index of the first pixel, stepped per pixel:
+    // down towards the centre column, then up again on the right half
+    int cordx = ball->centerx - startx;
+    int32_t arccosindex = abs(cordx) * step + 0x8000;
+
+    for (uint_fast8_t i = 0; i < stopx - startx; i++) {
+      if (pass->half && i > 0 && ((startx + i) & 1)) {
+        // Right half of a 2x2 block
+        longitudes[i] = longitudes[i - 1];
+        lines[i] = lines[i - 1];
+        cordx--;
+        arccosindex += cordx >= 0 ? -step : step;
+        continue;
+      }
+      uint16_t longitude = (cordx < 0 ?
+        FIXED_180_DEG - ball->arccos[arccosindex >> FIXED_360_DEG_SHIFT] :
+        ball->arccos[arccosindex >> FIXED_360_DEG_SHIFT]);
+      uint16_t latitude = originallatitude;
+
+      if (pass->rotated) {
+        // Convert to cartesian coordinates (confusion since y on screeen is z in 3d system)
+        int cordy = (sinlathead * sin_lookup(longitude) + 0x8000) >> FIXED_360_DEG_SHIFT;
+
+        // Multiplication (rotation by the x-axis)
+        // x'   | 1   0       0    | | x |     x' = x
+        // y' = | 0 cos(t)  sin(t) | | y | =>  y' = cos(t)*y + sin(t)*z
+        // z'   | 0 -sin(t) cos(t) | | z |     z' = -sin(t)*y + cos(t)*z
+        int xrot = cordx;
+        int yrot = (pass->coslat * cordy + cordzsinlat + 0x8000) >> FIXED_360_DEG_SHIFT;
+        int zrot = (-pass->sinlat * cordy + cordzcoslat + 0x8000) >> FIXED_360_DEG_SHIFT;
+
+        // convert to spherical coordinates
+        latitude = atan2_lookup(sqrt_lookup[xrot * xrot + yrot * yrot], zrot);
+        longitude = atan2_lookup(yrot, xrot);
+      }
+      uint_fast16_t line = (latitude * texturewidth) >> FIXED_360_DEG_SHIFT;
+      longitudes[i] = longitude;
+      lines[i] = line < lastline ? line : lastline;
+      cordx--;
+      arccosindex += cordx >= 0 ? -step : step;
+    }
+    draw_texels(ball, pass->kernel, rowdata, startx, stopx, longitudes, lines, pass->longitude_rotation);
+    if (fillrow && startx == ball->spans[row].xmin && stopx == ball->spans[row].xmax) {
+      // Later bands and frames at this latitude read the row from the cache
+      ball->spans[row].cached = true;
+    }
+    if (pass->half) {
+      pass->halfy = y;
+      pass->halfstartx = startx;
+      pass->halfstopx = stopx;
+    }
+  }
+}
+
+// Screen rectangle a target covers within clip, the target's top left pixel at origin
+static GRect target_clip(GBitmap *target, GPoint origin, GRect clip) {
+  GRect bounds = gbitmap_get_bounds(target);
+  int left = clip.origin.x > origin.x ? clip.origin.x : origin.x;
+  int top = clip.origin.y > origin.y ? clip.origin.y : origin.y;
+  int right = clip.origin.x + clip.size.w < origin.x + bounds.size.w ?
+    clip.origin.x + clip.size.w : origin.x + bounds.size.w;
+  int bottom = clip.origin.y + clip.size.h < origin.y + bounds.size.h ?
+    clip.origin.y + clip.size.h : origin.y + bounds.size.h;
+  return GRect(left, top, right > left ? right - left : 0, bottom > top ? bottom - top : 0);
+}
+
+// Target row of screen row y, indexed by screen column. Narrows [startx, stopx)
+// to the pixels the row holds on round displays.
+static uint8_t *target_row(GBitmap *target, GPoint origin, int y, int *startx, int *stopx) {
 #ifdef PBL_ROUND
-        /*if (x == ball->centerx)
-          APP_LOG(APP_LOG_LEVEL_INFO, "Round Draw position(%d, %d)", x, y);*/
-        DRAW_ROUND_PIXEL(info.data, x, app_config.inverted ? pixel ^ 0x7F : pixel);
-#elif PBL_COLOR
-        DRAW_COLOR_PIXEL(framebuffer, x, yoffset, app_config.inverted ? pixel ^ 0x7F : pixel);
+  GBitmapDataRowInfo info = gbitmap_get_data_row_info(target, y - origin.y);
+  if (*startx < info.min_x + origin.x) *startx = info.min_x + origin.x;
+  if (*stopx > info.max_x + 1 + origin.x) *stopx = info.max_x + 1 + origin.x;
+  return info.data - origin.x;
 #else
-        DRAW_BW_PIXEL(framebuffer, x, yoffset, app_config.inverted ? pixel ^ 0x01 : pixel);
+  return gbitmap_get_data(target) + (y - origin.y) * gbitmap_get_bytes_per_row(target) - ROW_BYTE(origin.x);
 #endif
+}
+
+// Renders the globe into target, whose top left pixel sits at origin on the screen.
+// Only screen pixels within clip are drawn, so a frame can be rendered in bands.
+// 1-bit targets need origin.x at a multiple of 8.
+void ball_render(Ball ball, GBitmap *target, GPoint origin, GRect clip,
+  int latitude_rotation, int longitude_rotation) {
+  init_tables(ball);
+  BallPass pass;
+  if (!begin_pass(ball, &pass, latitude_rotation, longitude_rotation)) return;
+  GRect area = target_clip(target, origin, clip);
+  int right = area.origin.x + area.size.w;
+  int bottom = area.origin.y + area.size.h;
+  // Half quality computes even rows at every other pixel and stretches them over odd rows
+  pass.half = ball->quality == BallQualityHalf;
+  pass.fillcache = pass.rotated && !pass.half && ball->field == BallFieldAll && ball->cachedrows > 0;
+  if (pass.rotated && !pass.usecache) {
+    // A new latitude drops the cached rows, the rows drawn whole from now on refill
+    // them, so frames rendered in bands fill the cache across their calls
+    for (int row = 0; row < (int)ball->cachedrows; row++) {
+      ball->spans[row].cached = false;
+    }
+    ball->cachedlatitude = pass.fillcache ? latitude_rotation : -1;
+    pass.usecache = pass.fillcache;
+  }
+
+  for (uint_fast8_t row = 0; row < ball->spanrows; row++) {
+    int y = ball->spantop + row;
+    if (ball->field != BallFieldAll && (y & 1) != (ball->field == BallFieldOdd)) continue;
+    int startx = ball->spans[row].xmin;
+    int stopx = ball->spans[row].xmax;
+    if (startx >= stopx) continue;
+    if (y < area.origin.y || y >= bottom) continue;
+    if (startx < area.origin.x) startx = area.origin.x;
+    if (stopx > right) stopx = right;
+    uint8_t *rowdata = target_row(target, origin, y, &startx, &stopx);
+    if (startx >= stopx) continue;
+    render_row(ball, &pass, row, rowdata, startx, stopx);
+  }
+}
+
+void ball_update_proc(Ball ball, Layer *layer, GContext *ctx, int latitude_rotation, int longitude_rotation)
+{
+  graphics_context_set_stroke_color(ctx, GColorWhite);
+  GBitmap *framebuffer = graphics_capture_frame_buffer(ctx);
+  ball_render(ball, framebuffer, GPointZero, gbitmap_get_bounds(framebuffer),
+    latitude_rotation, longitude_rotation);
+  graphics_release_frame_buffer(ctx, framebuffer);
+}
+
+// Copies the globe to the screen from a buffer ball_render drew it into, whose
+// top left pixel sits at origin on the screen. Pixels around the globe are left alone.
+void ball_present(Ball ball, GContext *ctx, GBitmap *source, GPoint origin) {
+  GBitmap *framebuffer = graphics_capture_frame_buffer(ctx);
+  GRect area = target_clip(source, origin, gbitmap_get_bounds(framebuffer));
+  int right = area.origin.x + area.size.w;
+  int bottom = area.origin.y + area.size.h;
+  uint8_t *sourcedata = gbitmap_get_data(source);
+  int sourcestride = gbitmap_get_bytes_per_row(source);
+  for (uint_fast8_t row = 0; row < ball->spanrows; row++) {
+    int y = ball->spantop + row;
+    if (y < area.origin.y) continue;
+    if (y >= bottom) break;
+    int startx = ball->spans[row].xmin > area.origin.x ? ball->spans[row].xmin : area.origin.x;
+    int stopx = ball->spans[row].xmax < right ? ball->spans[row].xmax : right;
+    uint8_t *rowdata = target_row(framebuffer, GPointZero, y, &startx, &stopx);
+    if (startx >= stopx) continue;
+    copy_row(rowdata, 0, sourcedata + (y - origin.y) * sourcestride, ROW_BYTE(origin.x), startx, stopx);
+  }
+  graphics_release_frame_buffer(ctx, framebuffer);
+}
+
+// Copies the globe from a buffer like ball_present, scaled to radius around center
+// by nearest neighbour sampling. Transitions show the last frame this way while the
+// globe moves, instead of rendering it at every size in between.
+void ball_present_scaled(Ball ball, GContext *ctx, GBitmap *source, GPoint origin,
+  GPoint center, int radius) {
+  if (radius <= 0 || ball->spanrows == 0) return;
+  GBitmap *framebuffer = graphics_capture_frame_buffer(ctx);
+  GRect bounds = gbitmap_get_bounds(framebuffer);
+  uint8_t *sourcedata = gbitmap_get_data(source);
+  int sourcestride = gbitmap_get_bytes_per_row(source);
+  // Source pixels per screen pixel, 16.16
+  int32_t step = ((int32_t)ball->radius << FIXED_360_DEG_SHIFT) / radius;
+  int top = center.y - radius > 0 ? center.y - radius : 0;
+  int bottom = center.y + radius < bounds.size.h ? center.y + radius : bounds.size.h;
+  int halfwidth = radius;
+  for (int y = top; y < bottom; y++) {
+    // Same circle as init_spans
+    int ydiff = abs(y - center.y);
+    while (halfwidth >= 0 && halfwidth * halfwidth + ydiff * ydiff >= radius * radius) halfwidth--;
+    while (halfwidth < radius && (halfwidth + 1) * (halfwidth + 1) + ydiff * ydiff < radius * radius) halfwidth++;
+    int startx = center.x - halfwidth > 0 ? center.x - halfwidth : 0;
+    int stopx = center.x + halfwidth + 1 < bounds.size.w ? center.x + halfwidth + 1 : bounds.size.w;
+    uint8_t *rowdata = target_row(framebuffer, GPointZero, y, &startx, &stopx);
+    if (startx >= stopx) continue;
+
+    int row = (int)ball->centery + (((y - center.y) * step + 0x8000) >> FIXED_360_DEG_SHIFT) - (int)ball->spantop;
+    if (row < 0) row = 0;
+    if (row >= (int)ball->spanrows) row = ball->spanrows - 1;
+    const BallSpan *span = &ball->spans[row];
+    if (span->xmin >= span->xmax) continue;
+    const uint8_t *sourcerow = sourcedata + (ball->spantop + row - origin.y) * sourcestride;
+    int32_t sourcex = ((int32_t)ball->centerx << FIXED_360_DEG_SHIFT) + (startx - center.x) * step + 0x8000;
+    for (int x = startx; x < stopx; x++, sourcex += step) {
+      int column = sourcex >> FIXED_360_DEG_SHIFT;
+      if (column < span->xmin) column = span->xmin;
+      if (column >= span->xmax) column = span->xmax - 1;
+      column -= origin.x;
+#ifdef PBL_COLOR
+      STORE_PIXEL(rowdata, x, sourcerow[column]);
+#else
+      if ((sourcerow[column >> 3] >> (column & 0x07)) & 1) {
+        rowdata[x >> 3] |= 1 << (x & 0x07);
+      } else {
+        rowdata[x >> 3] &= ~(1 << (x & 0x07));
       }
+#endif
     }
   }
   graphics_release_frame_buffer(ctx, framebuffer);
 }
 
-void draw_gps_position(Ball ball, Layer *layer, GContext *ctx,
+// Draws the 3x3 GPS marker into target like ball_render draws the globe
+void ball_render_gps_position(Ball ball, GBitmap *target, GPoint origin, GRect clip,
   int latitude_rotation, int longitude_rotation,
   uint16_t longitude, uint16_t latitude)
 {
-  GBitmap *framebuffer = graphics_capture_frame_buffer(ctx);
-#ifndef PBL_ROUND
-  uint8_t* framebufferdata = gbitmap_get_data(framebuffer);
-  uint8_t framebuffer_bytes_per_row = gbitmap_get_bytes_per_row(framebuffer);
-#endif
-
   int coslat = cos_lookup(latitude_rotation);
   int sinlat = sin_lookup(latitude_rotation);
 
@@ -237,24 +1279,30 @@ void draw_gps_position(Ball ball, Layer *layer, GContext *ctx,
   int myx = x + ball->centerx;
   int myy = (coslat * y + sinlat * z) >> FIXED_360_DEG_SHIFT;
   int myz = ((-sinlat * y + coslat * z) >> FIXED_360_DEG_SHIFT) + ball->centery;
-  if (myy > 0) {
-    for (int dz = -1; dz <= 1; dz++) {
-#ifdef PBL_ROUND
-      GBitmapDataRowInfo info = gbitmap_get_data_row_info(framebuffer, myz + dz);
-#else
-      int yoffset = (myz + dz) * framebuffer_bytes_per_row;
-#endif
-      for (int dx = -1; dx <= 1; dx++) {
-#ifdef PBL_ROUND
-        DRAW_ROUND_PIXEL(info.data, myx + dx, 0xF0);
-#elif PBL_COLOR
-        DRAW_COLOR_PIXEL(framebuffer, myx + dx, yoffset, 0xF0);
+  if (myy <= 0) return;
+
+  GRect area = target_clip(target, origin, clip);
+  for (int py = myz - 1; py <= myz + 1; py++) {
+    if (py < area.origin.y || py >= area.origin.y + area.size.h) continue;
+    int startx = myx - 1 > area.origin.x ? myx - 1 : area.origin.x;
+    int stopx = myx + 2 < area.origin.x + area.size.w ? myx + 2 : area.origin.x + area.size.w;
+    uint8_t *rowdata = target_row(target, origin, py, &startx, &stopx);
+    for (int px = startx; px < stopx; px++) {
+#ifdef PBL_COLOR
+      STORE_PIXEL(rowdata, px, 0xF0);
 #else
-        uint8_t pixel = 1;
-        DRAW_BW_PIXEL(framebuffer, myx + dx, yoffset, pixel);
+      rowdata[px >> 3] |= 1 << (px & 0x07);
 #endif
-      }
     }
   }
+}
+
+void draw_gps_position(Ball ball, Layer *layer, GContext *ctx,
+  int latitude_rotation, int longitude_rotation,
+  uint16_t longitude, uint16_t latitude)
+{
+  GBitmap *framebuffer = graphics_capture_frame_buffer(ctx);
+  ball_render_gps_position(ball, framebuffer, GPointZero, gbitmap_get_bounds(framebuffer),
+    latitude_rotation, longitude_rotation, longitude, latitude);
   graphics_release_frame_buffer(ctx, framebuffer);
 }
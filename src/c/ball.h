@@ -2,13 +2,51 @@
 
 typedef struct ball *Ball;
 
+typedef enum {
+  BallQualityFull,
+  // Rotated rows computed for the top left pixel of every 2x2 block
+  BallQualityHalf
+} BallQuality;
+
+typedef enum {
+  BallFieldAll,
+  // Only the even or odd screen rows, the others are left untouched
+  BallFieldEven,
+  BallFieldOdd
+} BallField;
+
 Ball create_ball(GBitmap *bitmap, int radius, int x, int y);
+Ball create_ball_native(GBitmap *bitmap, int radius, int x, int y);
+Ball create_ball_streamed(uint32_t resource_id, int radius, int x, int y);
 void update_ball(Ball ball, int radius, int x, int y);
+void ball_release_tables(Ball ball);
 void destroy_ball(Ball ball);
+void ball_set_inverted(Ball ball, bool inverted);
+void ball_set_quality(Ball ball, BallQuality quality);
+void ball_set_field(Ball ball, BallField field);
+void ball_render(Ball ball, GBitmap *target, GPoint origin, GRect clip,
+  int latitude_rotation, int longitude_rotation);
 void ball_update_proc(Ball ball, Layer *layer, GContext *ctx,
   int latitude_rotation, int longitude_rotation);
+GRect ball_get_bounds(Ball ball);
+GBitmap *ball_create_buffer(Ball ball);
+void ball_present(Ball ball, GContext *ctx, GBitmap *source, GPoint origin);
+void ball_present_scaled(Ball ball, GContext *ctx, GBitmap *source, GPoint origin,
+  GPoint center, int radius);
+void ball_render_gps_position(Ball ball, GBitmap *target, GPoint origin, GRect clip,
+  int latitude_rotation, int longitude_rotation,
+  uint16_t longitude, uint16_t latitude);
 void draw_gps_position(Ball ball, Layer *layer, GContext *ctx,
   int latitude_rotation, int longitude_rotation,
   uint16_t longitude, uint16_t latitude);
-
-void init_sqrt();
+bool ball_get_inverted(Ball ball);
+GBitmapFormat ball_get_format(Ball ball);
+int ball_get_texture_width(Ball ball);
+int ball_pixel_count(Ball ball, GRect bounds);
+int ball_get_radius(Ball ball);
+#ifdef GLOBE_VERIFY
+bool ball_texel(Ball ball, int x, int y, int latitude_rotation, int longitude_rotation,
+  uint16_t *latitude, uint16_t *longitude);
+int ball_get_row_texture_width(Ball ball, int y, int latitude_rotation);
+uint8_t ball_texel_color(Ball ball, int y, int latitude_rotation, uint16_t latitude, uint16_t longitude);
+#endif
@@ -0,0 +1,146 @@
+#include <pebble.h>
+#include "bench.h"
+#include "platform.h"
+
+#ifdef GLOBE_BENCHMARK
+// On-watch renderer benchmark, enabled by building with GLOBE_BENCHMARK=1.
+// Every case renders a sweep of longitudes at one radius and latitude and
+// logs ns/frame and pixels/s, so renderer changes can be compared per platform.
+// Rotated cases are timed twice: cold, with the latitude nudged every frame so
+// every pixel is projected, then warm, from the coordinate cache.
+
+// Host builds run more frames to time them with millisecond resolution
+#ifndef BENCH_FRAMES
+#define BENCH_FRAMES 32
+#endif
+#ifndef BENCH_GPS_FRAMES
+#define BENCH_GPS_FRAMES 256
+#endif
+#define BENCH_STEP_DELAY 100
+
+static const int bench_radii[] = { 60, 75 };
+// Latitudes without bits in 0xFF00 take the unrotated path
+static const int bench_latitudes[] = { 0x0000, 0x00C0, 0x0F00, 0x2000, 0xF000, 0xE000 };
+
+#define BENCH_RADII (int)(sizeof(bench_radii) / sizeof(bench_radii[0]))
+#define BENCH_LATITUDES (int)(sizeof(bench_latitudes) / sizeof(bench_latitudes[0]))
+#define BENCH_CASES (BENCH_RADII * BENCH_LATITUDES)
+
+typedef struct {
+  uint32_t ms;
+  uint32_t frames;
+  uint32_t pixels;
+} BenchTotal;
+
+static int bench_case = 0;
+static BenchTotal bench_rotated;
+static BenchTotal bench_cached;
+static BenchTotal bench_unrotated;
+static BenchTotal bench_gps;
+
+static const char *format_name(GBitmapFormat format) {
+  switch (format) {
+    case GBitmapFormat1Bit: return "1bit";
+    case GBitmapFormat8Bit: return "8bit";
+    case GBitmapFormat1BitPalette: return "1bitpal";
+    case GBitmapFormat2BitPalette: return "2bitpal";
+    case GBitmapFormat4BitPalette: return "4bitpal";
+    default: return "other";
+  }
+}
+
+// Tenths of a nanosecond per pixel, whole ones are too coarse for host builds
+static int decins_per_pixel(uint32_t ms, uint64_t pixels) {
+  return pixels > 0 ? (int)((uint64_t)ms * 10000000 / pixels) : 0;
+}
+
+static void log_total(const char *name, GBitmapFormat format, BenchTotal *total) {
+  if (total->frames == 0 || total->ms == 0) return;
+  int decins = decins_per_pixel(total->ms, total->pixels);
+  APP_LOG(APP_LOG_LEVEL_INFO, "bench %s %s %s: %d frames, %d ns/frame, %d px/s, %d.%d ns/px",
+    PLATFORM_NAME, format_name(format), name, (int)total->frames,
+    (int)((uint64_t)total->ms * 1000000 / total->frames),
+    (int)((uint64_t)total->pixels * 1000 / total->ms), decins / 10, decins % 10);
+}
+
+// Renders the sweep and adds it to total. Cold sweeps alternate between two
+// latitudes one angle unit apart, so the coordinate cache never hits.
+static void bench_sweep(Ball ball, Layer *layer, GContext *ctx, int radius, int latitude,
+  bool cold, int pixels, BenchTotal *total, const char *name) {
+  uint32_t start = now_ms();
+  for (int i = 0; i < BENCH_FRAMES; i++) {
+    ball_update_proc(ball, layer, ctx, cold ? latitude ^ (i & 1) : latitude, i * (0x10000 / BENCH_FRAMES));
+  }
+  uint32_t elapsed = now_ms() - start;
+
+  total->ms += elapsed;
+  total->frames += BENCH_FRAMES;
+  total->pixels += pixels * BENCH_FRAMES;
+  if (elapsed > 0) {
+    int decins = decins_per_pixel(elapsed, (uint64_t)pixels * BENCH_FRAMES);
+    APP_LOG(APP_LOG_LEVEL_INFO, "bench %s %s r%d lat 0x%x%s: %d ns/frame, %d px/s, %d.%d ns/px",
+      PLATFORM_NAME, format_name(ball_get_format(ball)), radius, latitude, name,
+      (int)((uint64_t)elapsed * 1000000 / BENCH_FRAMES),
+      (int)((uint64_t)pixels * BENCH_FRAMES * 1000 / elapsed), decins / 10, decins % 10);
+  }
+}
+
+static void bench_next(void *data) {
+  layer_mark_dirty((Layer *)data);
+}
+
+// Runs one benchmark case per call so the watchdog never sees a long block.
+// Returns true while the benchmark still owns the layer.
+bool benchmark_step(Ball ball, Layer *layer, GContext *ctx, int radius, int x, int y) {
+  if (bench_case > BENCH_CASES) return false;
+  GBitmapFormat format = ball_get_format(ball);
+
+  if (bench_case == BENCH_CASES) {
+    // Finally time the gps marker and restore the real globe geometry
+    update_ball(ball, radius, x, y);
+    uint32_t start = now_ms();
+    for (int i = 0; i < BENCH_GPS_FRAMES; i++) {
+      draw_gps_position(ball, layer, ctx, 0x1000, i * 0x100, 0x4000 + i * 0x80, 0x6000);
+    }
+    bench_gps.ms += now_ms() - start;
+    bench_gps.frames += BENCH_GPS_FRAMES;
+    bench_gps.pixels += BENCH_GPS_FRAMES * 9;
+
+    log_total("unrotated", format, &bench_unrotated);
+    log_total("rotated", format, &bench_rotated);
+    log_total("rotated cached", format, &bench_cached);
+    log_total("gps", format, &bench_gps);
+    bench_case++;
+    layer_mark_dirty(layer);
+    return false;
+  }
+
+  int benchradius = bench_radii[bench_case / BENCH_LATITUDES];
+  int latitude = bench_latitudes[bench_case % BENCH_LATITUDES];
+  update_ball(ball, benchradius, x, y);
+  if (ball_get_radius(ball) != benchradius) {
+    // Larger than the platform's sqrt table, the ball was clamped to a smaller radius
+    if (bench_case % BENCH_LATITUDES == 0) {
+      APP_LOG(APP_LOG_LEVEL_INFO, "bench %s %s r%d: skipped, largest radius is %d",
+        PLATFORM_NAME, format_name(format), benchradius, ball_get_radius(ball));
+    }
+    bench_case++;
+    app_timer_register(BENCH_STEP_DELAY, bench_next, layer);
+    return true;
+  }
+  int pixels = ball_pixel_count(ball, layer_get_bounds(layer));
+
+  if ((latitude & 0xFF00) == 0) {
+    bench_sweep(ball, layer, ctx, benchradius, latitude, false, pixels, &bench_unrotated, "");
+  } else {
+    bench_sweep(ball, layer, ctx, benchradius, latitude, true, pixels, &bench_rotated, "");
+    // The last cold frame left the other latitude cached, one frame fills it for this one
+    ball_update_proc(ball, layer, ctx, latitude, 0);
+    bench_sweep(ball, layer, ctx, benchradius, latitude, false, pixels, &bench_cached, " cached");
+  }
+
+  bench_case++;
+  app_timer_register(BENCH_STEP_DELAY, bench_next, layer);
+  return true;
+}
+#endif
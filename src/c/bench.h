@@ -0,0 +1,7 @@
+#pragma once
+
+#include "ball.h"
+
+#ifdef GLOBE_BENCHMARK
+bool benchmark_step(Ball ball, Layer *layer, GContext *ctx, int radius, int x, int y);
+#endif
@@ -36,16 +36,22 @@ static int dateny = -30;
 #define MAX_SECOND_TICKS 20
 
 void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
-  update_time();
+  // Second ticks only blink the GPS position, time and sun change per minute
+  if (units_changed & MINUTE_UNIT) {
+    update_time();
+  }
+  blink_gps_position();
   tick_count++;
-  if (tick_count == MAX_SECOND_TICKS && units_changed == SECOND_UNIT) {
+  if (tick_count == MAX_SECOND_TICKS) {
     tick_timer_service_subscribe(MINUTE_UNIT, tick_handler);
   }
 }
 
 void reset_ticks() {
   tick_count = 0;
-  tick_timer_service_subscribe(SECOND_UNIT, tick_handler);
+  // Seconds are only needed while there is a GPS position to blink
+  tick_timer_service_subscribe(currentlong != 0 ? SECOND_UNIT : MINUTE_UNIT, tick_handler);
+  update_time();
 }
 
 void clock_unobstructed_did_change(void *context) {
@@ -59,9 +65,6 @@ void clock_unobstructed_did_change(void *context) {
 
   // Move date shadow textlayer
   layer_set_frame((Layer *)s_date_shadow_layer, GRect(datex - 2, datey + 2,118,30));
-  update_globe();
-  if (app_config.animations)
-    spin_globe(0, 1);
 }
 
 static void set_colors() {
@@ -2,7 +2,12 @@
 #include "clock.h"
 #include "globe.h"
 #include "ball.h"
+#include "bench.h"
+#include "verify.h"
+#include "profile.h"
+#include "snapshot.h"
 #include "message.h"
+#include "platform.h"
 
 #define FIXED_360_DEG 0x10000
 #define FIXED_360_DEG_SHIFT 16
@@ -33,69 +38,319 @@ static int animation_count;
 static bool gpsposition = 0;
 bool animating = true;
 bool firstframe = true;
+// Frames painted during the current spin, which may have been retargeted
+static bool s_spinning = false;
+static uint16_t s_spin_frames;
+
+// Spin frames that take longer than this switch the renderer to half quality,
+// which switches back once a full frame (about three half frames) fits again
+#define ANIMATION_FRAME_BUDGET 33
+static BallQuality quality = BallQualityFull;
+static BallQuality framequality = BallQualityFull;
+static uint32_t framems = 0;
+
+// The globe is rendered into a front buffer that bg_update_proc copies to the screen,
+// so repaints that do not move it skip rendering. Idle refreshes prepare the new
+// position in the back buffer, or in the front one when the heap only fits one, and
+// swap when it is complete. Without either the globe is rendered straight to the screen.
+static GBitmap *s_front_buffer;
+static GBitmap *s_back_buffer;
+static GRect s_buffer_bounds;
+static bool s_front_valid;
+static bool s_front_filled;
+static int s_front_lat, s_front_long;
+// Launches show the frame saved by the last run until the globe is first painted
+static bool s_painted = false;
+
+// Spin frames only render every other row, alternating fields over the last frame
+static bool interlaced = false;
+static uint8_t field = 0;
+
+// Idle refreshes render a band of rows per timer callback, so taps and messages are
+// handled in between. Bands are resized to take about the budget.
+#define REFRESH_BAND_BUDGET 10
+#define REFRESH_BAND_DELAY 10
+#define REFRESH_BAND_ROWS 8
+static AppTimer *s_refresh_timer;
+static int s_band_rows = REFRESH_BAND_ROWS;
+// Next row of the refresh being prepared, -1 when there is none
+static int s_refresh_row = -1;
+static int s_refresh_lat, s_refresh_long;
+
+// While Quick View slides in or out the last frame is scaled to the globe of the
+// intermediate bounds, and the globe is only rebuilt once at the final ones
+static bool s_transition = false;
+static GPoint s_transition_center;
+static int s_transition_radius;
 
 static void update_animation_parameters();
 
+static void destroy_buffers() {
+  if (s_front_buffer) gbitmap_destroy(s_front_buffer);
+  if (s_back_buffer) gbitmap_destroy(s_back_buffer);
+  s_front_buffer = NULL;
+  s_back_buffer = NULL;
+}
+
+static void restore_snapshot() {
+  Snapshot snapshot = { .radius = globeradius, .centerx = globecenterx, .centery = globecentery,
+    .inverted = app_config.inverted };
+  if (!snapshot_load(s_front_buffer, &snapshot)) return;
+  s_front_valid = true;
+  s_front_filled = true;
+  s_front_lat = globelat = snapshot.latitude;
+  s_front_long = globelong = snapshot.longitude;
+}
+
+static void save_snapshot() {
+  if (!s_front_buffer || !s_front_valid || animating) return;
+  Snapshot snapshot = { .radius = globeradius, .centerx = globecenterx, .centery = globecentery,
+    .inverted = app_config.inverted, .latitude = s_front_lat, .longitude = s_front_long };
+  snapshot_save(s_front_buffer, &snapshot);
+}
+
+// Buffers for the globe at its current size and position
+static void init_buffers() {
+  destroy_buffers();
+  s_buffer_bounds = ball_get_bounds(globe);
+  s_front_buffer = ball_create_buffer(globe);
+  s_back_buffer = s_front_buffer ? ball_create_buffer(globe) : NULL;
+  s_front_valid = false;
+  s_front_filled = false;
+  s_refresh_row = -1;
+  if (s_front_buffer && !s_painted) restore_snapshot();
+  APP_LOG(APP_LOG_LEVEL_INFO, "Globe buffers %dx%d, front %d, back %d", s_buffer_bounds.size.w,
+    s_buffer_bounds.size.h, s_front_buffer != NULL, s_back_buffer != NULL);
+  if (!s_front_buffer) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Globe buffers dropped, every frame renders to the screen");
+  } else if (!s_back_buffer) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Back buffer dropped, idle refreshes render into the front buffer");
+  }
+}
+
+static void refresh_band(void *data) {
+  s_refresh_timer = NULL;
+  if (animating) return;
+  GBitmap *target = s_back_buffer ? s_back_buffer : s_front_buffer;
+  if (!target || (s_front_valid && s_front_lat == sunlat && s_front_long == sunlong)) {
+    // Nothing to prepare, the next update renders or copies the new position
+    globelong = sunlong;
+    globelat = sunlat;
+    layer_mark_dirty(s_simple_bg_layer);
+    return;
+  }
+  if (s_refresh_row < 0 || s_refresh_lat != sunlat || s_refresh_long != sunlong) {
+    s_refresh_row = 0;
+    s_refresh_lat = sunlat;
+    s_refresh_long = sunlong;
+    if (target == s_front_buffer) s_front_valid = false;
+  }
+
+  uint32_t start = now_ms();
+  ball_set_field(globe, BallFieldAll);
+  ball_render(globe, target, s_buffer_bounds.origin, GRect(s_buffer_bounds.origin.x,
+    s_buffer_bounds.origin.y + s_refresh_row, s_buffer_bounds.size.w, s_band_rows), sunlat, sunlong);
+  s_refresh_row += s_band_rows;
+  uint32_t ms = now_ms() - start;
+  if (ms > REFRESH_BAND_BUDGET && s_band_rows > 1) {
+    s_band_rows /= 2;
+  } else if (ms * 2 < REFRESH_BAND_BUDGET && s_band_rows < s_buffer_bounds.size.h) {
+    s_band_rows *= 2;
+  }
+  if (s_refresh_row < s_buffer_bounds.size.h) {
+    s_refresh_timer = app_timer_register(REFRESH_BAND_DELAY, refresh_band, NULL);
+    return;
+  }
+
+  s_refresh_row = -1;
+  if (target == s_back_buffer) {
+    s_back_buffer = s_front_buffer;
+    s_front_buffer = target;
+  }
+  s_front_valid = true;
+  s_front_filled = true;
+  s_front_lat = sunlat;
+  s_front_long = sunlong;
+  globelong = sunlong;
+  globelat = sunlat;
+  layer_mark_dirty(s_simple_bg_layer);
+}
+
+// Moves the idle globe to the sun position
+static void refresh_globe() {
+  if (!s_refresh_timer) s_refresh_timer = app_timer_register(0, refresh_band, NULL);
+}
+
 void set_sun_position(uint16_t longitude, int16_t latitude) {
+  if (!globe) {
+    sunlong = longitude;
+    sunlat = latitude;
+    return;
+  }
+  // The sun moves a quarter degree a minute and a texture column spans two,
+  // so the globe only follows once the sun lands in another column
+  int texturewidth = ball_get_texture_width(globe);
+  if (latitude == sunlat && ((longitude * texturewidth) >> FIXED_360_DEG_SHIFT) ==
+      (((uint16_t)sunlong * texturewidth) >> FIXED_360_DEG_SHIFT)) {
+    return;
+  }
   sunlong = longitude;
   sunlat = latitude;
   //APP_LOG(APP_LOG_LEVEL_INFO, "set_sun_position: sunlong %d, sunlat %d", sunlong, sunlat);
   if (animating) {
     update_animation_parameters();
   } else {
-    layer_mark_dirty(s_simple_bg_layer);
+    refresh_globe();
   }
+}
+
+void blink_gps_position() {
   gpsposition = !gpsposition;
+  if (currentlong != 0 && !animating) {
+    layer_mark_dirty(s_simple_bg_layer);
+  }
 }
 
 static void bg_update_proc(Layer *layer, GContext *ctx) {
-  if (!animating) {
-    globelong = sunlong;
-    globelat = sunlat;
+  if (!globe) return;
+#ifdef GLOBE_BENCHMARK
+  if (benchmark_step(globe, layer, ctx, globeradius, globecenterx, globecentery)) return;
+#endif
+#ifdef GLOBE_VERIFY
+  if (verify_step(globe, s_globe_bitmap, layer, ctx, globeradius, globecenterx, globecentery)) return;
+#endif
+#ifdef GLOBE_PROFILE
+  profile_frame_begin();
+#endif
+  s_painted = true;
+  if (s_spinning) s_spin_frames++;
+  uint32_t start = now_ms();
+  bool interlace = interlaced && s_front_buffer && s_front_filled;
+  ball_set_field(globe, !interlace ? BallFieldAll : field ? BallFieldOdd : BallFieldEven);
+  if (s_transition && s_front_buffer && s_front_filled) {
+    ball_present_scaled(globe, ctx, s_front_buffer, s_buffer_bounds.origin, s_transition_center,
+      s_transition_radius);
+  } else if (!s_front_buffer) {
+    ball_update_proc(globe, layer, ctx, globelat, globelong);
+  } else {
+    if (!s_front_valid || s_front_lat != globelat || s_front_long != globelong) {
+      ball_render(globe, s_front_buffer, s_buffer_bounds.origin, s_buffer_bounds, globelat, globelong);
+      // Only whole full quality frames are kept for repaints
+      s_front_valid = !interlace && quality == BallQualityFull;
+      s_front_filled = s_front_filled || !interlace;
+      s_front_lat = globelat;
+      s_front_long = globelong;
+      // A refresh prepared in the front buffer starts over
+      if (!s_back_buffer) s_refresh_row = -1;
+      if (interlace) field ^= 1;
+    }
+    ball_present(globe, ctx, s_front_buffer, s_buffer_bounds.origin);
   }
+  framems = now_ms() - start;
+  framequality = quality;
 
-  ball_update_proc(globe, layer, ctx, globelat, globelong);
-
-  if (currentlong != 0 && gpsposition) {
+  if (currentlong != 0 && gpsposition && !s_transition) {
     draw_gps_position(globe, layer, ctx, globelat, globelong, currentlong, currentlat);
   }
+#ifdef GLOBE_PROFILE
+  profile_frame_end(((globelat & 0xFF00) != 0 ? PROFILE_FRAME_ROTATED : 0) |
+    (animating ? PROFILE_FRAME_ANIMATING : 0));
+  static bool profiled = false;
+  if (!profiled) {
+    profile_heap("first frame");
+    profiled = true;
+  }
+#endif
 }
 
+// Spin controller. At most one spin Animation runs: a trigger during a spin replaces
+// it with one that carries on from the current position, so the spin is extended or
+// redirected instead of stacked. Triggers in the same direction while a full turn is
+// still ahead are merged into the spin.
+#define ANIMATION_DURATION 5000
+#define ANIMATION_INITIAL_DELAY 500
+static Animation *s_spin_animation;
 static int longitude_start = 0;
 static int longitude_length = 0;
 static int latitude_start = 0;
 static int latitude_length = 0;
-static Animation* s_globe_animation;
-#define ANIMATION_DURATION 5000
-#define ANIMATION_INITIAL_DELAY 500
+static AnimationProgress s_spin_progress;
+static uint8_t s_spin_triggers;
+static SpinHandler s_spin_handler;
+
+void set_spin_handler(SpinHandler handler) {
+  s_spin_handler = handler;
+}
+
+// Distance to the sun in the spin direction plus a full turn
+static int spin_length(int start) {
+  return (uint16_t)((sunlong - start) * animation_direction) + FIXED_360_DEG;
+}
 
 static void anim_started_handler(Animation* anim, void* context) {
   longitude_start = globelong;
-  longitude_length = abs(sunlong - globelong) + FIXED_360_DEG;
+  longitude_length = spin_length(globelong);
   latitude_start = globelat;
-  latitude_length = sunlat - globelat;
+  // The shortest way round, globelat starts at 0xF000 while sunlat is signed
+  latitude_length = (int16_t)(sunlat - globelat);
+  s_spin_progress = 0;
+  // A retargeted spin carries on
+  if (s_spinning) return;
+  s_spinning = true;
+  s_spin_frames = 0;
   animating = true;
   firstframe = true;
   animation_count = 0;
   tick_timer_service_unsubscribe();
+  interlaced = true;
 }
 
 static void update_animation_parameters() {
-  longitude_length = abs(sunlong - longitude_start) + FIXED_360_DEG;
+  longitude_length = spin_length(longitude_start);
 }
 
 static void anim_stopped_handler(Animation* anim, bool finished, void* context) {
   animation_destroy(anim);
+  // Replaced by a retargeted spin
+  if (anim != s_spin_animation) return;
+  s_spin_animation = NULL;
+  s_spinning = false;
   animating = false;
   GColor background = app_config.inverted ? GColorWhite : GColorBlack;
   background_color = background;
   reset_ticks();
   //APP_LOG(APP_LOG_LEVEL_INFO, "Animation count %d", animation_count);
+  // The resting frame is always rendered in full, at full quality
+  quality = BallQualityFull;
+  ball_set_quality(globe, quality);
+  interlaced = false;
+  refresh_globe();
+  if (s_spin_handler) s_spin_handler(s_spin_frames, s_spin_triggers);
+}
+
+// Picks the quality of the next spin frame from the cost of the last one
+static void update_quality() {
+  if (framequality != quality) return;
+  bool slow = quality == BallQualityFull ?
+    framems > ANIMATION_FRAME_BUDGET : framems * 3 >= ANIMATION_FRAME_BUDGET;
+  if (quality == BallQualityFull && slow) {
+    quality = BallQualityHalf;
+  } else if (quality == BallQualityHalf && !slow) {
+    quality = BallQualityFull;
+  } else {
+    return;
+  }
+  ball_set_quality(globe, quality);
 }
 
 static void anim_update_handler(Animation* anim, AnimationProgress progress) {
-  globelong = longitude_start + animation_direction * longitude_length * progress / ANIMATION_NORMALIZED_MAX;
-  globelat = latitude_start + latitude_length * progress / ANIMATION_NORMALIZED_MAX;
+  s_spin_progress = progress;
+  globelong = longitude_start + (int)((int64_t)animation_direction * longitude_length * progress / ANIMATION_NORMALIZED_MAX);
+  globelat = (int16_t)(latitude_start + (int)((int64_t)latitude_length * progress / ANIMATION_NORMALIZED_MAX));
+  update_quality();
+#ifdef GLOBE_PROFILE
+  profile_frame_requested();
+#endif
   layer_mark_dirty(s_simple_bg_layer);
   if (animation_count == 1) {
     firstframe = false;
@@ -109,35 +364,55 @@ static AnimationImplementation spin_animation = {
 };
 
 void spin_globe(int delay, int direction) {
-  s_globe_animation = animation_create();
-  animation_set_delay((Animation*)s_globe_animation, delay);
-  animation_set_duration((Animation*)s_globe_animation, ANIMATION_DURATION);
-  animation_set_curve((Animation*)s_globe_animation, delay != 0 ? AnimationCurveEaseInOut : AnimationCurveEaseOut);
-  animation_set_handlers((Animation*)s_globe_animation, (AnimationHandlers) {
+  if (!globe) return;
+  if (s_spin_animation) {
+    if (s_spin_triggers < UINT8_MAX) s_spin_triggers++;
+    int remaining = (int64_t)longitude_length * (ANIMATION_NORMALIZED_MAX - s_spin_progress) / ANIMATION_NORMALIZED_MAX;
+    if (direction == animation_direction && (!s_spinning || remaining >= FIXED_360_DEG)) return;
+    // Already moving, so the new spin starts at once without easing in
+    Animation *replaced = s_spin_animation;
+    s_spin_animation = NULL;
+    animation_unschedule(replaced);
+    delay = 0;
+  } else {
+    s_spin_triggers = 1;
+  }
+  s_spin_animation = animation_create();
+  animation_set_delay(s_spin_animation, delay);
+  animation_set_duration(s_spin_animation, ANIMATION_DURATION);
+  animation_set_curve(s_spin_animation, delay != 0 ? AnimationCurveEaseInOut : AnimationCurveEaseOut);
+  animation_set_handlers(s_spin_animation, (AnimationHandlers) {
     .started = anim_started_handler,
     .stopped = anim_stopped_handler
   }, NULL);
   animation_direction = direction;
-  animation_set_implementation((Animation*)s_globe_animation, &spin_animation);
-  animation_schedule((Animation*)s_globe_animation);
+  animation_set_implementation(s_spin_animation, &spin_animation);
+  animation_schedule(s_spin_animation);
 }
 
-static void set_globe_size(GRect bounds) {
-  globeradius = bounds.size.h / 2;
-  if (globeradius > maxgloberadius) globeradius = maxgloberadius;
-  globecenterx = bounds.size.w / 2;
-  globecentery = bounds.size.h / 2;
+// Radius and center of the globe drawn in bounds
+static int globe_geometry(GRect bounds, GPoint *center) {
+  int radius = bounds.size.h / 2;
+  if (radius > maxgloberadius) radius = maxgloberadius;
+  center->x = bounds.size.w / 2;
+  center->y = bounds.size.h / 2;
   #ifdef PBL_RECT
-  if (globecentery > 60 && !app_config.center) globecentery += 10;
+  if (center->y > 60 && !app_config.center) center->y += 10;
   #endif
+  return radius;
+}
+
+static void set_globe_size(GRect bounds) {
+  GPoint center;
+  globeradius = globe_geometry(bounds, &center);
+  globecenterx = center.x;
+  globecentery = center.y;
   APP_LOG(APP_LOG_LEVEL_INFO, "Globecentery %d", globecentery);
   xres = bounds.size.w;
   yres = bounds.size.h;
 }
 
 void init_globe(Window *window) {
-  init_sqrt();
-
   window_ref = window;
   window_layer = window_get_root_layer(window);
   GRect bounds = layer_get_unobstructed_bounds(window_layer);
@@ -148,25 +423,91 @@ void init_globe(Window *window) {
   //APP_LOG(APP_LOG_LEVEL_INFO, "Bytes per row: %d", bytes);
   //GBitmapFormat format = gbitmap_get_format(s_globe_bitmap);
   //APP_LOG(APP_LOG_LEVEL_INFO, "Bitmap format: %d", (int)format);
-  globe = create_ball(s_globe_bitmap, globeradius, globecenterx, globecentery);
+  if (s_globe_bitmap) {
+    globe = create_ball(s_globe_bitmap, globeradius, globecenterx, globecentery);
+  } else {
+    // Stream the texture where the platform supports it when the heap can not hold it whole
+    globe = create_ball_streamed(RESOURCE_ID_IMAGE_GLOBE, globeradius, globecenterx, globecentery);
+  }
+  if (globe) {
+    ball_set_inverted(globe, app_config.inverted);
+    init_buffers();
+  } else {
+    // The watchface keeps its time and complications without a globe
+    APP_LOG(APP_LOG_LEVEL_ERROR, "No memory for the globe texture, the globe is not drawn");
+  }
 
   s_simple_bg_layer = layer_create(bounds);
   layer_set_update_proc(s_simple_bg_layer, bg_update_proc);
   layer_add_child(window_get_root_layer(window), s_simple_bg_layer);
   spin_globe(ANIMATION_INITIAL_DELAY, 1);
+#ifdef GLOBE_PROFILE
+  set_spin_handler(profile_spin);
+  profile_heap("init_globe");
+#endif
 }
 
+// Applies the current bounds and settings. The buffers and the frame in them are
+// only dropped when the globe moved or changed colours.
 void update_globe() {
   GRect bounds = layer_get_unobstructed_bounds(window_layer);
   layer_set_bounds(s_simple_bg_layer, bounds);
+  int radius = globeradius;
+  int centerx = globecenterx, centery = globecentery;
   set_globe_size(bounds);
+  if (!globe) return;
+
+  if (globeradius != radius || (int)globecenterx != centerx || (int)globecentery != centery) {
+    destroy_buffers();
+    update_ball(globe, globeradius, globecenterx, globecentery);
+    ball_set_inverted(globe, app_config.inverted);
+    init_buffers();
+  } else if (ball_get_inverted(globe) != app_config.inverted) {
+    ball_set_inverted(globe, app_config.inverted);
+    s_front_valid = false;
+    s_front_filled = false;
+    s_refresh_row = -1;
+    if (s_front_buffer && !s_painted) restore_snapshot();
+  }
+  layer_mark_dirty(s_simple_bg_layer);
+}
 
-  update_ball(globe, globeradius, globecenterx, globecentery);
+void globe_unobstructed_will_change(GRect final_unobstructed_screen_area, void *context) {
+  s_transition = true;
+  s_transition_center = GPoint(globecenterx, globecentery);
+  s_transition_radius = globeradius;
+}
+
+void globe_unobstructed_change(AnimationProgress progress, void *context) {
+  s_transition_radius = globe_geometry(layer_get_unobstructed_bounds(window_layer), &s_transition_center);
   layer_mark_dirty(s_simple_bg_layer);
 }
 
+void globe_unobstructed_did_change(void *context) {
+  s_transition = false;
+  GPoint center;
+  int radius = globe_geometry(layer_get_unobstructed_bounds(window_layer), &center);
+  if (radius == globeradius && center.x == (int)globecenterx && center.y == (int)globecentery) {
+    // Back where it started, the buffers still hold the globe
+    layer_set_bounds(s_simple_bg_layer, layer_get_unobstructed_bounds(window_layer));
+    layer_mark_dirty(s_simple_bg_layer);
+  } else {
+    update_globe();
+  }
+  if (app_config.animations && app_config.quickViewSpin) spin_globe(0, 1);
+}
+
 void destroy_globe() {
-  destroy_ball(globe);
-  gbitmap_destroy(s_globe_bitmap);
+  if (s_spin_animation) {
+    // Stopped without settling the globe
+    Animation *spin = s_spin_animation;
+    s_spin_animation = NULL;
+    animation_unschedule(spin);
+  }
+  if (s_refresh_timer) app_timer_cancel(s_refresh_timer);
+  save_snapshot();
+  destroy_buffers();
+  if (globe) destroy_ball(globe);
+  if (s_globe_bitmap) gbitmap_destroy(s_globe_bitmap);
   layer_destroy(s_simple_bg_layer);
 }
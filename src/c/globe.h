@@ -1,7 +1,15 @@
 #pragma once
 
+// Called when a spin ends with the frames it painted and the triggers merged into it
+typedef void (*SpinHandler)(uint16_t frames, uint8_t triggers);
+
 void spin_globe();
 void init_globe(Window *window);
 void update_globe();
 void destroy_globe();
 void set_sun_position(uint16_t longitude, int16_t latitude);
+void blink_gps_position();
+void set_spin_handler(SpinHandler handler);
+void globe_unobstructed_will_change(GRect final_unobstructed_screen_area, void *context);
+void globe_unobstructed_change(AnimationProgress progress, void *context);
+void globe_unobstructed_did_change(void *context);
@@ -8,23 +8,14 @@
 
 Window *main_window;
 
+// Taps during a spin are merged into it or retarget it by the spin controller
 static void tap_handler(AccelAxisType axis, int32_t direction) {
-  static time_t last_tap = 0;
-  time_t seconds;
-
-  time_ms(&seconds, NULL);
-
-  if (seconds - last_tap < 5) {
-    last_tap = seconds;
-    return;
-  }
-
-  last_tap = seconds;
   if (app_config.animations)
     spin_globe(0, direction);
 }
 
 static void main_unobstructed_did_change(void *context) {
+    globe_unobstructed_did_change(context);
     clock_unobstructed_did_change(context);
     #ifdef PBL_HEALTH
     health_unobstructed_did_change(context);
@@ -65,6 +56,8 @@ void handle_init(void) {
 
   // Subscribe to Quick View events
   UnobstructedAreaHandlers handlers = {
+    .will_change = globe_unobstructed_will_change,
+    .change = globe_unobstructed_change,
     .did_change = main_unobstructed_did_change
   };
   unobstructed_area_service_subscribe(handlers, NULL);
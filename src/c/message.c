@@ -3,22 +3,30 @@
 #include "clock.h"
 #include "globe.h"
 #include "health.h"
+#include "profile.h"
 
 Window* window_ref;
 Layer* root_layer;
 int currentlong;
 int currentlat;
 int16_t timezone_offset;
-Config app_config = { .showDate = true, .showHealth = true, .animations = true, .inverted = false, .bold = false, .showBattery = true, .center = false };
+Config app_config = { .showDate = true, .showHealth = true, .animations = true, .inverted = false, .bold = false, .showBattery = true, .center = false, .quickViewSpin = false };
 GColor background_color;
 #define SETTINGS_KEY 1
 
+// True when a setting the globe is drawn with differs from previous, other
+// settings and position updates leave the globe and its cached frame alone
+static bool globe_settings_changed(const Config *previous) {
+  return app_config.inverted != previous->inverted || app_config.center != previous->center;
+}
+
 // Read settings from persistent storage
 static void prv_load_settings() {
   // Read settings from persistent storage, if they exist
+  Config previous = app_config;
   persist_read_data(SETTINGS_KEY, &app_config, sizeof(app_config));
   background_color = app_config.inverted ? GColorWhite : GColorBlack;
-  update_globe();
+  if (globe_settings_changed(&previous)) update_globe();
   update_time();
   #ifdef PBL_HEALTH
   update_health();
@@ -34,6 +42,15 @@ static void prv_save_settings() {
 }
 
 static void inbox_received_callback(DictionaryIterator *iterator, void *context) {
+  // Profile dump requests carry no settings
+  if (dict_find(iterator, MESSAGE_KEY_ProfileRequest)) {
+#ifdef GLOBE_PROFILE
+    profile_send();
+#endif
+    return;
+  }
+  Config previous = app_config;
+
   // Longitude
   Tuple *longitude_t = dict_find(iterator, MESSAGE_KEY_KEY_LONGITUDE);
   if (longitude_t) {
@@ -92,14 +109,30 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
     app_config.animations = animations_t->value->int32 == 1;
   }
 
+  // Spin after Quick View
+  Tuple *quickViewSpin_t = dict_find(iterator, MESSAGE_KEY_QuickViewSpin);
+  if (quickViewSpin_t) {
+    app_config.quickViewSpin = quickViewSpin_t->value->int32 == 1;
+  }
+
   // Save the new settings to persistent storage
   prv_save_settings();
-  update_globe();
+  if (globe_settings_changed(&previous)) update_globe();
   update_time();
   #ifdef PBL_HEALTH
   update_health();
   #endif
   layer_mark_dirty(root_layer);
+#ifdef GLOBE_PROFILE
+  profile_heap("settings");
+  // The first message shows pkjs is up, so send the first dump unasked; pkjs
+  // polls only after it, and release builds never send one
+  static bool s_profile_announced = false;
+  if (!s_profile_announced) {
+    s_profile_announced = true;
+    profile_send();
+  }
+#endif
 }
 
 static void inbox_dropped_callback(AppMessageResult reason, void *context) {
@@ -135,7 +168,11 @@ void message_init(Window *window) {
   app_message_register_outbox_sent(outbox_sent_callback);
 
   // Open AppMessage
+#ifdef GLOBE_PROFILE
+  app_message_open(320, PROFILE_OUTBOX_SIZE);
+#else
   app_message_open(320, 0);
+#endif
 }
 
 void message_deinit() {
@@ -8,6 +8,7 @@ typedef struct config {
   bool bold;
   bool showBattery;
   bool center;
+  bool quickViewSpin;
 } Config;
 
 extern int currentlong;
@@ -0,0 +1,43 @@
+#include <pebble.h>
+#include "palette.h"
+
+#if defined(PBL_COLOR) && (defined(GLOBE_VERIFY) || defined(GLOBE_BENCHMARK))
+// Palettised copy of an 8-bit texture for the 4-bit and 2-bit palette formats,
+// used by the verification and the host benchmark. The palette keeps the first
+// colours it meets, later ones map to entry 0, and is freed with the bitmap.
+GBitmap *create_palettised(GBitmap *texture, GBitmapFormat format) {
+  int bits = format == GBitmapFormat4BitPalette ? 4 : 2;
+  int colors = 1 << bits;
+  GRect bounds = gbitmap_get_bounds(texture);
+  GColor *palette = calloc(colors, sizeof(GColor));
+  if (!palette) return NULL;
+  GBitmap *bitmap = gbitmap_create_blank_with_palette(bounds.size, format, palette, true);
+  if (!bitmap) {
+    free(palette);
+    return NULL;
+  }
+  int used = 0;
+  int perbyte = 8 / bits;
+  uint8_t *source = gbitmap_get_data(texture);
+  int sourcewidth = gbitmap_get_bytes_per_row(texture);
+  uint8_t *data = gbitmap_get_data(bitmap);
+  int width = gbitmap_get_bytes_per_row(bitmap);
+  memset(data, 0, width * bounds.size.h);
+  for (int y = 0; y < bounds.size.h; y++) {
+    for (int x = 0; x < bounds.size.w; x++) {
+      uint8_t color = source[y * sourcewidth + x];
+      int index = 0;
+      while (index < used && palette[index].argb != color) index++;
+      if (index == used) {
+        if (used < colors) {
+          palette[used++].argb = color;
+        } else {
+          index = 0;
+        }
+      }
+      data[y * width + x / perbyte] |= index << ((perbyte - 1 - x % perbyte) * bits);
+    }
+  }
+  return bitmap;
+}
+#endif
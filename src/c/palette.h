@@ -0,0 +1,7 @@
+#pragma once
+
+#include <pebble.h>
+
+#if defined(PBL_COLOR) && (defined(GLOBE_VERIFY) || defined(GLOBE_BENCHMARK))
+GBitmap *create_palettised(GBitmap *texture, GBitmapFormat format);
+#endif
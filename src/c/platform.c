@@ -0,0 +1,10 @@
+#include <pebble.h>
+#include "platform.h"
+
+// Wall clock milliseconds, wrapping, for timing frames and benchmark cases
+uint32_t now_ms() {
+  time_t seconds;
+  uint16_t ms;
+  time_ms(&seconds, &ms);
+  return (uint32_t)seconds * 1000 + ms;
+}
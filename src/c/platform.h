@@ -0,0 +1,20 @@
+#pragma once
+
+#include <pebble.h>
+
+// Name of the platform the app was built for, as the SDK calls it
+#if defined(PBL_PLATFORM_APLITE)
+#define PLATFORM_NAME "aplite"
+#elif defined(PBL_PLATFORM_BASALT)
+#define PLATFORM_NAME "basalt"
+#elif defined(PBL_PLATFORM_CHALK)
+#define PLATFORM_NAME "chalk"
+#elif defined(PBL_PLATFORM_DIORITE)
+#define PLATFORM_NAME "diorite"
+#elif defined(PBL_PLATFORM_EMERY)
+#define PLATFORM_NAME "emery"
+#else
+#define PLATFORM_NAME "unknown"
+#endif
+
+uint32_t now_ms();
@@ -0,0 +1,105 @@
+#include <pebble.h>
+#include "profile.h"
+#include "platform.h"
+
+#ifdef GLOBE_PROFILE
+// Runtime profiling, enabled by building with GLOBE_PROFILE=1.
+//
+// The heap is sampled at points of interest (launch, first frame, settings
+// changes) and each sample is logged with the high-water marks of all samples.
+//
+// Frame render times are kept in a ring buffer of the last PROFILE_FRAMES frames,
+// with the frame type and the number of animation frames dropped before each one.
+// pkjs requests a dump with ProfileRequest and logs it as CSV.
+
+#define PROFILE_FRAMES 64
+// Milliseconds (little endian), flags and dropped frames
+#define PROFILE_FRAME_BYTES 4
+
+typedef struct {
+  uint16_t ms;
+  uint8_t flags;
+  uint8_t dropped;
+} ProfileFrame;
+
+static size_t s_peak_used = 0;
+static size_t s_low_free = 0;
+static bool s_sampled = false;
+
+static ProfileFrame s_frames[PROFILE_FRAMES];
+static uint32_t s_frame_count = 0;
+static uint32_t s_frame_start = 0;
+static bool s_frame_pending = false;
+static uint8_t s_frame_dropped = 0;
+static uint32_t s_dropped = 0;
+static uint32_t s_spins = 0;
+static uint32_t s_spin_frames = 0;
+
+void profile_heap(const char *label) {
+  size_t used = heap_bytes_used();
+  size_t free = heap_bytes_free();
+  if (!s_sampled || used > s_peak_used) s_peak_used = used;
+  if (!s_sampled || free < s_low_free) s_low_free = free;
+  s_sampled = true;
+  APP_LOG(APP_LOG_LEVEL_INFO, "heap %s: %d used, %d free, peak %d used, low %d free", label,
+    (int)used, (int)free, (int)s_peak_used, (int)s_low_free);
+}
+
+// An animation step asked for a frame, the previous request is dropped if
+// it has not been rendered yet
+void profile_frame_requested() {
+  if (s_frame_pending) {
+    s_dropped++;
+    if (s_frame_dropped < UINT8_MAX) s_frame_dropped++;
+  }
+  s_frame_pending = true;
+}
+
+void profile_frame_begin() {
+  s_frame_start = now_ms();
+}
+
+void profile_frame_end(uint8_t flags) {
+  uint32_t ms = now_ms() - s_frame_start;
+  ProfileFrame *frame = &s_frames[s_frame_count % PROFILE_FRAMES];
+  frame->ms = ms < UINT16_MAX ? ms : UINT16_MAX;
+  frame->flags = flags;
+  frame->dropped = s_frame_dropped;
+  s_frame_count++;
+  s_frame_dropped = 0;
+  s_frame_pending = false;
+}
+
+// Spin hook, logs the frames painted per spin and the average over all spins
+void profile_spin(uint16_t frames, uint8_t triggers) {
+  s_spins++;
+  s_spin_frames += frames;
+  APP_LOG(APP_LOG_LEVEL_INFO, "profile spin: %d frames, %d triggers, %d frames per spin over %d spins",
+    (int)frames, (int)triggers, (int)(s_spin_frames / s_spins), (int)s_spins);
+}
+
+// Sends the frames recorded since the last dump, oldest first
+void profile_send() {
+  DictionaryIterator *iterator;
+  if (app_message_outbox_begin(&iterator) != APP_MSG_OK) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Profile outbox busy!");
+    return;
+  }
+  static uint8_t data[PROFILE_FRAMES * PROFILE_FRAME_BYTES];
+  int frames = s_frame_count < PROFILE_FRAMES ? (int)s_frame_count : PROFILE_FRAMES;
+  for (int i = 0; i < frames; i++) {
+    ProfileFrame *frame = &s_frames[(s_frame_count - frames + i) % PROFILE_FRAMES];
+    uint8_t *bytes = data + i * PROFILE_FRAME_BYTES;
+    bytes[0] = frame->ms & 0xFF;
+    bytes[1] = frame->ms >> 8;
+    bytes[2] = frame->flags;
+    bytes[3] = frame->dropped;
+  }
+  dict_write_data(iterator, MESSAGE_KEY_ProfileData, data, frames * PROFILE_FRAME_BYTES);
+  dict_write_cstring(iterator, MESSAGE_KEY_ProfilePlatform, PLATFORM_NAME);
+  dict_write_int32(iterator, MESSAGE_KEY_ProfileDropped, s_dropped);
+  app_message_outbox_send();
+  s_frame_count = 0;
+  s_dropped = 0;
+}
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <pebble.h>
+
+#ifdef GLOBE_PROFILE
+// Frame flags recorded by the frame profiler
+#define PROFILE_FRAME_ROTATED 0x01
+#define PROFILE_FRAME_ANIMATING 0x02
+
+// Outbox for profile dumps, 64 frames of 4 bytes plus the platform and drop count
+#define PROFILE_OUTBOX_SIZE 320
+
+void profile_heap(const char *label);
+void profile_frame_requested();
+void profile_frame_begin();
+void profile_frame_end(uint8_t flags);
+void profile_spin(uint16_t frames, uint8_t triggers);
+void profile_send();
+#endif
@@ -0,0 +1,193 @@
+#include <pebble.h>
+#include "snapshot.h"
+
+// The last idle globe frame, kept in persistent storage so a relaunch shows it at
+// once instead of waiting for the first render. Frames are PackBits compressed and
+// spread over keys of at most PERSIST_DATA_MAX_LENGTH bytes. The header is written
+// last, so a save cut short leaves no snapshot rather than a broken one.
+//
+// Apps get 4 KB of persistent storage in total. 1-bit frames pack to about 1.5 KB,
+// 8-bit ones to 3 to 6 KB and are only saved when they fit.
+
+#define SNAPSHOT_KEY 16
+#define SNAPSHOT_CHUNKS 14
+#define SNAPSHOT_BUDGET (SNAPSHOT_CHUNKS * PERSIST_DATA_MAX_LENGTH)
+// Bumped when frames of the same globe would render differently
+#define SNAPSHOT_VERSION 1
+
+typedef struct {
+  uint8_t version;
+  uint8_t format;
+  uint8_t inverted;
+  uint8_t radius;
+  uint8_t centerx;
+  uint8_t centery;
+  uint16_t stride;
+  uint16_t height;
+  uint16_t bytes;
+  int32_t latitude;
+  int32_t longitude;
+} SnapshotHeader;
+
+typedef struct {
+  uint8_t chunk[PERSIST_DATA_MAX_LENGTH];
+  int used;
+  int length;
+  uint32_t key;
+  int remaining;
+} SnapshotStream;
+
+static bool flush_chunk(SnapshotStream *stream) {
+  if (stream->used == 0) return true;
+  if (stream->key >= SNAPSHOT_KEY + 1 + SNAPSHOT_CHUNKS) return false;
+  if (persist_write_data(stream->key++, stream->chunk, stream->used) != stream->used) return false;
+  stream->used = 0;
+  return true;
+}
+
+static bool write_bytes(SnapshotStream *stream, const uint8_t *data, int length) {
+  while (length > 0) {
+    if (stream->used == PERSIST_DATA_MAX_LENGTH && !flush_chunk(stream)) return false;
+    int count = PERSIST_DATA_MAX_LENGTH - stream->used;
+    if (count > length) count = length;
+    memcpy(stream->chunk + stream->used, data, count);
+    stream->used += count;
+    data += count;
+    length -= count;
+  }
+  return true;
+}
+
+// Next byte of the snapshot, -1 past its end or when a chunk is missing
+static int read_byte(SnapshotStream *stream) {
+  if (stream->remaining == 0) return -1;
+  if (stream->used == stream->length) {
+    if (stream->key >= SNAPSHOT_KEY + 1 + SNAPSHOT_CHUNKS) return -1;
+    int length = persist_read_data(stream->key++, stream->chunk, PERSIST_DATA_MAX_LENGTH);
+    if (length <= 0) return -1;
+    stream->length = length;
+    stream->used = 0;
+  }
+  stream->remaining--;
+  return stream->chunk[stream->used++];
+}
+
+// PackBits: a code n below 128 is followed by n + 1 literal bytes, a code above
+// 128 by one byte repeated 257 - n times. Without a stream it only counts the
+// packed size. Returns the packed size, -1 if the stream could not be written.
+static int pack(const uint8_t *data, int length, SnapshotStream *stream) {
+  int size = 0;
+  int i = 0;
+  while (i < length) {
+    int run = 1;
+    while (i + run < length && run < 128 && data[i + run] == data[i]) run++;
+    if (run >= 2) {
+      uint8_t code[2] = { 257 - run, data[i] };
+      if (stream && !write_bytes(stream, code, 2)) return -1;
+      size += 2;
+      i += run;
+      continue;
+    }
+    // Literals up to the next run
+    int literal = 1;
+    while (i + literal < length && literal < 128 &&
+           !(i + literal + 1 < length && data[i + literal] == data[i + literal + 1])) {
+      literal++;
+    }
+    uint8_t code = literal - 1;
+    if (stream && (!write_bytes(stream, &code, 1) || !write_bytes(stream, data + i, literal))) return -1;
+    size += 1 + literal;
+    i += literal;
+  }
+  return size;
+}
+
+static bool unpack(uint8_t *data, int length, SnapshotStream *stream) {
+  int written = 0;
+  while (written < length) {
+    int code = read_byte(stream);
+    if (code < 0 || code == 128) return false;
+    int count = code < 128 ? code + 1 : 257 - code;
+    if (written + count > length) return false;
+    if (code < 128) {
+      for (int i = 0; i < count; i++) {
+        int byte = read_byte(stream);
+        if (byte < 0) return false;
+        data[written++] = byte;
+      }
+    } else {
+      int byte = read_byte(stream);
+      if (byte < 0) return false;
+      memset(data + written, byte, count);
+      written += count;
+    }
+  }
+  return stream->remaining == 0;
+}
+
+static void fill_header(SnapshotHeader *header, GBitmap *bitmap, const Snapshot *snapshot) {
+  memset(header, 0, sizeof(SnapshotHeader));
+  header->version = SNAPSHOT_VERSION;
+  header->format = gbitmap_get_format(bitmap);
+  header->inverted = snapshot->inverted;
+  header->radius = snapshot->radius;
+  header->centerx = snapshot->centerx;
+  header->centery = snapshot->centery;
+  header->stride = gbitmap_get_bytes_per_row(bitmap);
+  header->height = gbitmap_get_bounds(bitmap).size.h;
+}
+
+// True if the saved frame suits bitmap and the globe of snapshot
+static bool read_header(SnapshotHeader *saved, GBitmap *bitmap, const Snapshot *snapshot) {
+  if (persist_read_data(SNAPSHOT_KEY, saved, sizeof(SnapshotHeader)) != sizeof(SnapshotHeader)) return false;
+  SnapshotHeader header;
+  fill_header(&header, bitmap, snapshot);
+  return saved->version == header.version && saved->format == header.format &&
+    saved->inverted == header.inverted && saved->radius == header.radius &&
+    saved->centerx == header.centerx && saved->centery == header.centery &&
+    saved->stride == header.stride && saved->height == header.height;
+}
+
+// Saves the frame in bitmap, rendered for snapshot, unless the same frame is saved
+// already. Frames over the budget keep the previous snapshot.
+void snapshot_save(GBitmap *bitmap, const Snapshot *snapshot) {
+  SnapshotHeader header;
+  if (read_header(&header, bitmap, snapshot) && header.latitude == snapshot->latitude &&
+      header.longitude == snapshot->longitude) {
+    return;
+  }
+  fill_header(&header, bitmap, snapshot);
+  header.latitude = snapshot->latitude;
+  header.longitude = snapshot->longitude;
+  uint8_t *data = gbitmap_get_data(bitmap);
+  int length = header.stride * header.height;
+  int bytes = pack(data, length, NULL);
+  if (bytes > SNAPSHOT_BUDGET) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "Snapshot not saved, %d bytes packed from %d", bytes, length);
+    return;
+  }
+  persist_delete(SNAPSHOT_KEY);
+  SnapshotStream stream = { .used = 0, .key = SNAPSHOT_KEY + 1 };
+  if (pack(data, length, &stream) < 0 || !flush_chunk(&stream)) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Snapshot write failed");
+    return;
+  }
+  header.bytes = bytes;
+  persist_write_data(SNAPSHOT_KEY, &header, sizeof(header));
+  APP_LOG(APP_LOG_LEVEL_INFO, "Snapshot saved, %d bytes packed from %d", bytes, length);
+}
+
+// Restores the saved frame into bitmap if it was rendered for the same globe,
+// filling in the position it shows
+bool snapshot_load(GBitmap *bitmap, Snapshot *snapshot) {
+  SnapshotHeader header;
+  if (!read_header(&header, bitmap, snapshot)) return false;
+  SnapshotStream stream = { .used = 0, .length = 0, .key = SNAPSHOT_KEY + 1, .remaining = header.bytes };
+  if (!unpack(gbitmap_get_data(bitmap), header.stride * header.height, &stream)) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Snapshot damaged");
+    return false;
+  }
+  snapshot->latitude = header.latitude;
+  snapshot->longitude = header.longitude;
+  return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <pebble.h>
+
+// The globe a saved frame was rendered for, only restored into an identical globe
+typedef struct {
+  int radius;
+  int centerx, centery;
+  bool inverted;
+  int latitude;
+  int longitude;
+} Snapshot;
+
+void snapshot_save(GBitmap *bitmap, const Snapshot *snapshot);
+bool snapshot_load(GBitmap *bitmap, Snapshot *snapshot);
@@ -0,0 +1,8 @@
+#pragma once
+
+// Lookup tables generated into the build directory by wscript
+
+// sqrt_lookup[i] is the integer square root of i for every
+// i < sqrt_lookup_size, which depends on the platform's largest globe
+extern const int sqrt_lookup_size;
+extern const int8_t sqrt_lookup[];
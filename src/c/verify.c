@@ -0,0 +1,300 @@
+#include <pebble.h>
+#include "verify.h"
+#include "message.h"
+#include "palette.h"
+
+#ifdef GLOBE_VERIFY
+// On-watch regression check for the globe renderer, enabled by building with
+// GLOBE_VERIFY=1. Every rendered pixel must have the colour of a texel within
+// REF_TOLERANCE rows and columns of a double precision projection that shares no
+// code with ball.c, and must match ball_texel(), the one-pixel-at-a-time fixed-point
+// projection. The fixed-point texture coordinates are compared against the double
+// precision ones to report texel error histograms for the arccos (unrotated) and
+// sqrt/atan2 (rotated) paths.
+
+#define REF_PI 3.14159265358979323846
+// The fixed-point lookups may round a pixel into the neighbouring texel, or
+// anywhere else the pixel covers where texels narrow towards the poles
+#define REF_TOLERANCE 1
+#define REF_FOOTPRINT 0.5
+#define REF_FOOTPRINT_STEPS 4
+#define ERROR_BUCKETS 4
+
+static const int verify_latitudes[] = { 0x0000, 0x00C0, 0x0F00, 0x2000, 0xF000, 0xE000 };
+static const int verify_longitudes[] = { 0x0000, 0x1234, 0x8000, 0xC000 };
+
+#define VERIFY_LATITUDES (int)(sizeof(verify_latitudes) / sizeof(verify_latitudes[0]))
+#define VERIFY_LONGITUDES (int)(sizeof(verify_longitudes) / sizeof(verify_longitudes[0]))
+#define VERIFY_FRAMES (VERIFY_LATITUDES * VERIFY_LONGITUDES)
+#ifdef PBL_COLOR
+// The native texture, then 4-bit and 2-bit palettised copies of it
+#define VERIFY_FORMATS 3
+#else
+#define VERIFY_FORMATS 1
+#endif
+#define VERIFY_CASES (VERIFY_FORMATS * VERIFY_FRAMES)
+#define VERIFY_STEP_DELAY 100
+
+typedef struct {
+  uint32_t pixels;
+  uint32_t mismatches;
+  uint32_t outliers;
+  uint32_t row_error[ERROR_BUCKETS];
+  uint32_t column_error[ERROR_BUCKETS];
+} VerifyTotal;
+
+static int verify_case = 0;
+static Ball verify_ball;
+static GBitmap *verify_texture;
+static VerifyTotal verify_unrotated;
+static VerifyTotal verify_rotated;
+
+static double ref_sqrt(double v) {
+  if (v <= 0) return 0;
+  double r = v > 1 ? v : 1;
+  for (int i = 0; i < 32; i++) r = 0.5 * (r + v / r);
+  return r;
+}
+
+// atan for |z| <= 1: two argument halvings, then the Taylor series
+static double ref_atan(double z) {
+  z = z / (1 + ref_sqrt(1 + z * z));
+  z = z / (1 + ref_sqrt(1 + z * z));
+  double z2 = z * z;
+  double term = z;
+  double sum = 0;
+  for (int n = 1; n < 24; n += 2) {
+    sum += term / n;
+    term *= -z2;
+  }
+  return 4 * sum;
+}
+
+// atan2 in [0, 2pi)
+static double ref_atan2(double y, double x) {
+  double a;
+  if (x == 0 && y == 0) return 0;
+  if ((x < 0 ? -x : x) >= (y < 0 ? -y : y)) {
+    a = ref_atan(y / x);
+    if (x < 0) a += REF_PI;
+  } else {
+    a = REF_PI / 2 - ref_atan(x / y);
+    if (y < 0) a += REF_PI;
+  }
+  if (a < 0) a += 2 * REF_PI;
+  if (a >= 2 * REF_PI) a -= 2 * REF_PI;
+  return a;
+}
+
+// sin and cos of a in [-pi, pi] by their Taylor series
+static void ref_sincos(double a, double *sin, double *cos) {
+  double s = 0, c = 0;
+  double term = 1;
+  for (int n = 0; n < 40; n++) {
+    if (n & 1) {
+      s += (n & 2) ? -term : term;
+    } else {
+      c += (n & 2) ? -term : term;
+    }
+    term *= a / (n + 1);
+  }
+  *sin = s;
+  *cos = c;
+}
+
+// Exact orthographic projection of a screen point to texel row and column
+static void ref_texel(int radius, int centerx, int centery, double x, double y,
+  int latitude_rotation, int longitude_rotation, int texturewidth, int *row, int *column) {
+  double cordx = centerx - x;
+  double cordz = centery - y;
+  double depth = (double)radius * radius - cordx * cordx - cordz * cordz;
+  double cordy = ref_sqrt(depth);
+  double sinlat = 0, coslat = 1;
+  if ((latitude_rotation & 0xFF00) != 0) {
+    double t = (int16_t)latitude_rotation * 2 * REF_PI / 0x10000;
+    ref_sincos(t, &sinlat, &coslat);
+  }
+  double xrot = cordx;
+  double yrot = coslat * cordy + sinlat * cordz;
+  double zrot = -sinlat * cordy + coslat * cordz;
+  double latitude = ref_atan2(ref_sqrt(xrot * xrot + yrot * yrot), zrot);
+  double longitude = ref_atan2(yrot, xrot) + (uint16_t)longitude_rotation * 2 * REF_PI / 0x10000;
+  if (longitude >= 2 * REF_PI) longitude -= 2 * REF_PI;
+  *row = (int)(latitude * texturewidth / (2 * REF_PI));
+  *column = (int)(longitude * texturewidth / (2 * REF_PI)) % texturewidth;
+}
+
+// True when the pixel on screen row y has the colour of a texel within
+// REF_TOLERANCE of the reference row and column of the mip level texturewidth
+// wide. Rows stop at the poles, columns wrap around.
+static bool near_texel(Ball ball, uint8_t pixel, int y, int latitude_rotation, int row, int column,
+  int texturewidth) {
+  for (int r = row - REF_TOLERANCE; r <= row + REF_TOLERANCE; r++) {
+    if (r < 0 || r > (texturewidth - 1) / 2) continue;
+    for (int c = column - REF_TOLERANCE; c <= column + REF_TOLERANCE; c++) {
+      // Texel centres, so that the renderer's own rounding maps them back to r and c
+      uint16_t latitude = (((uint32_t)r << 16) + 0x8000) / texturewidth;
+      uint16_t longitude = (((uint32_t)((c + texturewidth) % texturewidth) << 16) + 0x8000) / texturewidth;
+      if (ball_texel_color(ball, y, latitude_rotation, latitude, longitude) == pixel) return true;
+    }
+  }
+  return false;
+}
+
+// True when the pixel is near the texel the reference projects it to, or near
+// the texel of any point of a grid over the pixel
+static bool near_reference(Ball ball, uint8_t pixel, int radius, int centerx, int centery,
+  int x, int y, int latitude_rotation, int longitude_rotation, int texturewidth, int row, int column) {
+  if (near_texel(ball, pixel, y, latitude_rotation, row, column, texturewidth)) return true;
+  for (int dy = -REF_FOOTPRINT_STEPS / 2; dy <= REF_FOOTPRINT_STEPS / 2; dy++) {
+    for (int dx = -REF_FOOTPRINT_STEPS / 2; dx <= REF_FOOTPRINT_STEPS / 2; dx++) {
+      if (dx == 0 && dy == 0) continue;
+      ref_texel(radius, centerx, centery,
+        x + dx * 2 * REF_FOOTPRINT / REF_FOOTPRINT_STEPS, y + dy * 2 * REF_FOOTPRINT / REF_FOOTPRINT_STEPS,
+        latitude_rotation, longitude_rotation, texturewidth, &row, &column);
+      if (near_texel(ball, pixel, y, latitude_rotation, row, column, texturewidth)) return true;
+    }
+  }
+  return false;
+}
+
+static void add_error(uint32_t *histogram, int error) {
+  if (error < 0) error = -error;
+  histogram[error < ERROR_BUCKETS ? error : ERROR_BUCKETS - 1]++;
+}
+
+static uint8_t read_pixel(GBitmap *framebuffer, int x, int y, bool *visible) {
+#ifdef PBL_ROUND
+  GBitmapDataRowInfo info = gbitmap_get_data_row_info(framebuffer, y);
+  *visible = x >= info.min_x && x <= info.max_x;
+  return *visible ? info.data[x] : 0;
+#else
+  uint8_t *data = gbitmap_get_data(framebuffer) + y * gbitmap_get_bytes_per_row(framebuffer);
+  *visible = true;
+#ifdef PBL_COLOR
+  return data[x];
+#else
+  return (data[x >> 3] >> (x & 0x07)) & 1;
+#endif
+#endif
+}
+
+static void log_total(const char *name, VerifyTotal *total) {
+  APP_LOG(APP_LOG_LEVEL_INFO, "verify %s: %s, %d px, %d off the reference, %d mismatches", name,
+    total->outliers == 0 && total->mismatches == 0 ? "PASS" : "FAIL", (int)total->pixels,
+    (int)total->outliers, (int)total->mismatches);
+  APP_LOG(APP_LOG_LEVEL_INFO, "verify %s texel error rows 0:%d 1:%d 2:%d 3+:%d", name,
+    (int)total->row_error[0], (int)total->row_error[1], (int)total->row_error[2], (int)total->row_error[3]);
+  APP_LOG(APP_LOG_LEVEL_INFO, "verify %s texel error columns 0:%d 1:%d 2:%d 3+:%d", name,
+    (int)total->column_error[0], (int)total->column_error[1], (int)total->column_error[2], (int)total->column_error[3]);
+}
+
+static void verify_next(void *data) {
+  layer_mark_dirty((Layer *)data);
+}
+
+// Verifies one frame per call. Returns true while verification owns the layer.
+bool verify_step(Ball ball, GBitmap *texture, Layer *layer, GContext *ctx, int radius, int x, int y) {
+  if (verify_case > VERIFY_CASES) return false;
+
+  if (verify_case == VERIFY_CASES) {
+    log_total("arccos", &verify_unrotated);
+    log_total("sqrt/atan2", &verify_rotated);
+    verify_case++;
+    layer_mark_dirty(layer);
+    return false;
+  }
+
+  int frame = verify_case % VERIFY_FRAMES;
+  Ball testball = ball;
+#ifdef PBL_COLOR
+  int format = verify_case / VERIFY_FRAMES;
+  if (format > 0) {
+    if (frame == 0) {
+      if (verify_ball) destroy_ball(verify_ball);
+      if (verify_texture) gbitmap_destroy(verify_texture);
+      verify_ball = NULL;
+      verify_texture = NULL;
+      if (texture && gbitmap_get_format(texture) == GBitmapFormat8Bit) {
+        // The copies get the heap of the native ball's tables, it rebuilds them when it renders again
+        ball_release_tables(ball);
+        verify_texture = create_palettised(texture,
+          format == 1 ? GBitmapFormat4BitPalette : GBitmapFormat2BitPalette);
+      }
+      if (verify_texture) verify_ball = create_ball_native(verify_texture, radius, x, y);
+    }
+    if (!verify_ball) {
+      // Skip formats that can not be derived from this texture
+      verify_case = (format + 1) * VERIFY_FRAMES;
+      app_timer_register(VERIFY_STEP_DELAY, verify_next, layer);
+      return true;
+    }
+    testball = verify_ball;
+  }
+#endif
+
+  int latitude_rotation = verify_latitudes[frame / VERIFY_LONGITUDES];
+  int longitude_rotation = verify_longitudes[frame % VERIFY_LONGITUDES];
+  ball_update_proc(testball, layer, ctx, latitude_rotation, longitude_rotation);
+
+  VerifyTotal frametotal = { 0 };
+  int texturewidth = ball_get_texture_width(testball);
+  GBitmap *framebuffer = graphics_capture_frame_buffer(ctx);
+  GRect bounds = gbitmap_get_bounds(framebuffer);
+  for (int py = y - radius; py < y + radius; py++) {
+    if (py < 0 || py >= bounds.size.h) continue;
+    for (int px = x - radius; px < x + radius; px++) {
+      if (px < 0 || px >= bounds.size.w) continue;
+      uint16_t latitude, longitude;
+      if (!ball_texel(testball, px, py, latitude_rotation, longitude_rotation, &latitude, &longitude)) continue;
+      bool visible;
+      uint8_t pixel = read_pixel(framebuffer, px, py, &visible);
+      if (!visible) continue;
+
+      frametotal.pixels++;
+      if (pixel != ball_texel_color(testball, py, latitude_rotation, latitude, longitude)) frametotal.mismatches++;
+
+      int row, column;
+      ref_texel(radius, x, y, px, py, latitude_rotation, longitude_rotation, texturewidth, &row, &column);
+      // Rows towards the poles and the limb sample a coarser mip level
+      int levelwidth = ball_get_row_texture_width(testball, py, latitude_rotation);
+      int levelrow = row, levelcolumn = column;
+      if (levelwidth != texturewidth) {
+        ref_texel(radius, x, y, px, py, latitude_rotation, longitude_rotation, levelwidth, &levelrow, &levelcolumn);
+      }
+      if (!near_reference(testball, pixel, radius, x, y, px, py, latitude_rotation, longitude_rotation,
+          levelwidth, levelrow, levelcolumn)) {
+        frametotal.outliers++;
+      }
+      add_error(frametotal.row_error, ((latitude * texturewidth) >> 16) - row);
+      int columnerror = abs(((longitude * texturewidth) >> 16) - column);
+      add_error(frametotal.column_error, columnerror > texturewidth / 2 ? texturewidth - columnerror : columnerror);
+    }
+  }
+  graphics_release_frame_buffer(ctx, framebuffer);
+
+  if (frametotal.outliers > 0 || frametotal.mismatches > 0) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "verify format %d lat 0x%x long 0x%x: %d of %d pixels off the reference, %d differ",
+      (int)ball_get_format(testball), latitude_rotation, longitude_rotation,
+      (int)frametotal.outliers, (int)frametotal.pixels, (int)frametotal.mismatches);
+  }
+  VerifyTotal *total = (latitude_rotation & 0xFF00) != 0 ? &verify_rotated : &verify_unrotated;
+  total->pixels += frametotal.pixels;
+  total->mismatches += frametotal.mismatches;
+  total->outliers += frametotal.outliers;
+  for (int i = 0; i < ERROR_BUCKETS; i++) {
+    total->row_error[i] += frametotal.row_error[i];
+    total->column_error[i] += frametotal.column_error[i];
+  }
+
+  verify_case++;
+  if (verify_case == VERIFY_CASES && verify_ball) {
+    destroy_ball(verify_ball);
+    gbitmap_destroy(verify_texture);
+    verify_ball = NULL;
+    verify_texture = NULL;
+  }
+  app_timer_register(VERIFY_STEP_DELAY, verify_next, layer);
+  return true;
+}
+#endif
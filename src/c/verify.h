@@ -0,0 +1,7 @@
+#pragma once
+
+#include "ball.h"
+
+#ifdef GLOBE_VERIFY
+bool verify_step(Ball ball, GBitmap *texture, Layer *layer, GContext *ctx, int radius, int x, int y);
+#endif
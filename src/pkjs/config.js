@@ -47,6 +47,12 @@ module.exports = [
         "label": "Enable Animations on shake",
         "defaultValue": true
       },
+      {
+        "type": "toggle",
+        "messageKey": "QuickViewSpin",
+        "label": "Spin the globe after Quick View",
+        "defaultValue": false
+      },
       {
         "type": "toggle",
         "messageKey": "ShowDate",
@@ -59,6 +59,36 @@ function getPosition() {
   );
 }
 
+// Frame profile dumps, only sent by GLOBE_PROFILE=1 builds. The watch sends the
+// first one unasked, so release builds see no profile traffic at all
+var PROFILE_INTERVAL = 60000;
+var PROFILE_FRAME_BYTES = 4;
+
+function requestProfile() {
+  sendToPebble({ 'ProfileRequest': 1 });
+}
+
+// Logs a dump as CSV lines: profile,platform,frame,ms,rotated,animating,dropped
+function logProfile(payload) {
+  var data = payload.ProfileData || [];
+  var platform = payload.ProfilePlatform;
+  console.log('profile,platform,frame,ms,rotated,animating,dropped');
+  for (var i = 0; i + PROFILE_FRAME_BYTES <= data.length; i += PROFILE_FRAME_BYTES) {
+    var ms = data[i] | (data[i + 1] << 8);
+    var flags = data[i + 2];
+    console.log(['profile', platform, i / PROFILE_FRAME_BYTES, ms,
+      flags & 1 ? 1 : 0, flags & 2 ? 1 : 0, data[i + 3]].join(','));
+  }
+  console.log('profile ' + platform + ' dropped ' + payload.ProfileDropped + ' frames since last dump');
+}
+
+Pebble.addEventListener('appmessage', function(e) {
+  if (e.payload.ProfilePlatform !== undefined) {
+    logProfile(e.payload);
+    setTimeout(requestProfile, PROFILE_INTERVAL);
+  }
+});
+
 // Listen for when the watchface is opened
 Pebble.addEventListener('ready', function() {
     console.log('PebbleKit JS ready!');
@@ -0,0 +1,65 @@
+#!/usr/bin/env python
+"""
+Summarises frame profiles from GLOBE_PROFILE=1 builds.
+
+pkjs logs each profile dump as CSV lines starting with 'profile,'. Capture them
+with `pebble logs > profile.log` (once per platform, or all into one file) and run
+
+    tools/profile_summary.py profile.log [more.log ...]
+
+to print render time percentiles per platform and frame type.
+"""
+import sys
+
+PERCENTILES = [50, 90, 99]
+
+
+def percentile(values, p):
+    """Nearest-rank percentile of sorted values"""
+    rank = max(1, -(-len(values) * p // 100))
+    return values[rank - 1]
+
+
+def frame_type(rotated, animating):
+    return '{} {}'.format('rotated' if rotated else 'unrotated', 'animating' if animating else 'idle')
+
+
+def read_frames(lines):
+    """Yields (platform, type, ms, dropped) for every CSV row in the log lines"""
+    for line in lines:
+        start = line.find('profile,')
+        if start < 0:
+            continue
+        fields = line[start:].strip().split(',')
+        if len(fields) != 7 or fields[1] == 'platform':
+            continue
+        try:
+            ms, rotated, animating, dropped = [int(field) for field in fields[3:]]
+        except ValueError:
+            continue
+        yield fields[1], frame_type(rotated, animating), ms, dropped
+
+
+def main(paths):
+    frames = {}
+    for path in paths:
+        with open(path) if path != '-' else sys.stdin as log:
+            for platform, kind, ms, dropped in read_frames(log):
+                frames.setdefault((platform, kind), []).append((ms, dropped))
+    if not frames:
+        print('No profile frames found')
+        return 1
+
+    header = '{:<10} {:<20} {:>7}'.format('platform', 'frame', 'frames') + \
+        ''.join('{:>7}'.format('p{}'.format(p)) for p in PERCENTILES) + '{:>7} {:>8}'.format('max', 'dropped')
+    print(header)
+    for (platform, kind), samples in sorted(frames.items()):
+        times = sorted(ms for ms, _ in samples)
+        print('{:<10} {:<20} {:>7}'.format(platform, kind, len(times)) +
+              ''.join('{:>7}'.format(percentile(times, p)) for p in PERCENTILES) +
+              '{:>7} {:>8}'.format(times[-1], sum(dropped for _, dropped in samples)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:] or ['-']))